@@ -4,42 +4,48 @@
 #include "fps.h"
 #include "animbitmap.h"
 #include "geom.h"
+#include "geomtests.h"
+#include "swapchain.h"
 #include "gdiplus.h"
 
 #pragma comment(lib, "gdiplus.lib")
 
 HBRUSH hbr;
 CAppModule _Module;
-AnimBitmap bmp;
+SwapChain<AnimBitmap> chain(2);
 long TestID = 0;
-const long TID_Fill = 0;
-const long TID_GDICircle = 1;
-const long TID_GDIPlusCircle = 2;
-const long TID_FilledCircleG = 3;
-const long TID_FilledCircleAAG = 5;
-const long TID_DonutG = 7;
-const long TID_DonutAAG = 8;
 
-Gdiplus::Graphics* graphics = 0;
 Gdiplus::SolidBrush* bluePen = 0;
 FPS f;
 
 
-void DontOptimizeOut(...)
+// shows the frames, on the swap chain's thread.  only what changed, unless WM_PAINT asked for all.
+struct Presenter
 {
-}
+  HWND hWnd;
+  std::atomic<bool> bRepaint;
 
-/*
-  Integer math color mixing function
-*/
-inline RgbPixel MixColorsInt(long fa, long fmax, RgbPixel ca, RgbPixel cb)
+  void operator()(AnimBitmap& bmp)
+  {
+    HDC h = GetDC(hWnd);
+    if(bRepaint.exchange(false))
+    {
+      bmp.Blit(h, 0, 0);
+      bmp.MarkPresented();
+    }
+    else
+    {
+      bmp.BlitDirty(h, 0, 0);
+    }
+    ReleaseDC(hWnd, h);
+  }
+};
+
+Presenter presenter;
+
+
+void DontOptimizeOut(...)
 {
-  BYTE r, g, b;
-  long fmaxminusfa = fmax - fa;
-  r = static_cast<BYTE>(((fa * R(ca)) + (fmaxminusfa * R(cb))) / fmax);
-  g = static_cast<BYTE>(((fa * G(ca)) + (fmaxminusfa * G(cb))) / fmax);
-  b = static_cast<BYTE>(((fa * B(ca)) + (fmaxminusfa * B(cb))) / fmax);
-  return MakeRgbPixel(r,g,b);
 }
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
@@ -73,6 +79,51 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
       case '6':
         TestID = TID_DonutAAG;
         break;
+      case '7':
+        TestID = TID_DonutAABands;
+        break;
+      case '8':
+        TestID = TID_FilledEllipseG;
+        break;
+      case '9':
+        TestID = TID_FilledEllipseAAG;
+        break;
+      case 'e':
+        TestID = TID_EllipseRingG;
+        break;
+      case 'c':
+        TestID = TID_DonutAAGClipped;
+        break;
+      case 'l':
+        TestID = TID_LineG;
+        break;
+      case 'a':
+        TestID = TID_LineAAG;
+        break;
+      case 't':
+        TestID = TID_ThickLineAAG;
+        break;
+      case 'f':
+        TestID = TID_FilledCircleAARows;
+        break;
+      case 'r':
+        TestID = TID_DonutAARows;
+        break;
+      case 'g':
+        TestID = TID_CircleGridAAG;
+        break;
+      case 'b':
+        TestID = TID_DrawCirclesAA;
+        break;
+      case 's':
+        TestID = TID_ScanlineCirclesAA;
+        break;
+      case 'm':
+        TestID = TID_MaskCompositeAA;
+        break;
+      case 'k':
+        TestID = TID_StampCirclesAA;
+        break;
       }
       return 0;
     }
@@ -84,16 +135,12 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
   case WM_PAINT:
     PAINTSTRUCT ps;
     BeginPaint(hWnd, &ps);
+    // frames only send what changed, so anything uncovered needs the next one sent in full
+    presenter.bRepaint = true;
     EndPaint(hWnd, &ps);
     return 0;
   case WM_SIZE:
-    bmp.SetSize(LOWORD(lParam), HIWORD(lParam));
-    if(graphics)
-    {
-      delete graphics;
-    }
-    graphics = new Gdiplus::Graphics(bmp.GetDC());
-    graphics->SetSmoothingMode(Gdiplus::SmoothingModeAntiAlias);
+    chain.SetSize(LOWORD(lParam), HIWORD(lParam));
     return 0;
   case WM_ERASEBKGND:
     return 0;
@@ -101,34 +148,6 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
   return DefWindowProc(hWnd, uMsg, wParam, lParam);
 }
 
-class Test
-{
-public:
-  void DonutAA2_SetAlphaPixel(long cx, long cy, long x, long y, long f, long fmax)
-  {
-    //bmp.SetPixel(cx+x, cy+y, MixColorsInt(f, fmax, MakeRgbPixel(255,255,255), bmp.GetPixel(cx+x, cy+y)));
-    //bmp.SetPixel(cx+x, cy-y-1, MixColorsInt(f, fmax, MakeRgbPixel(255,255,255), bmp.GetPixel(cx+x, cy-y-1)));
-    //bmp.SetPixel(cx-x-1, cy+y, MixColorsInt(f, fmax, MakeRgbPixel(255,255,255), bmp.GetPixel(cx-x-1, cy+y)));
-    //bmp.SetPixel(cx-x-1, cy-y-1, MixColorsInt(f, fmax, MakeRgbPixel(255,255,255), bmp.GetPixel(cx-x-1, cy-y-1)));
-    bmp.SetPixel(cx+x, cy+y, MixColorsInt(2, 10, MakeRgbPixel(255,0,0), bmp.GetPixel(cx+x, cy+y)));
-    bmp.SetPixel(cx+x, cy-y-1, MixColorsInt(2, 10, MakeRgbPixel(255,0,0), bmp.GetPixel(cx+x, cy-y-1)));
-    bmp.SetPixel(cx-x-1, cy+y, MixColorsInt(2, 10, MakeRgbPixel(255,0,0), bmp.GetPixel(cx-x-1, cy+y)));
-    bmp.SetPixel(cx-x-1, cy-y-1, MixColorsInt(2, 10, MakeRgbPixel(255,0,0), bmp.GetPixel(cx-x-1, cy-y-1)));
-  }
-  void DonutAAG_Hline(long x1, long x2, long y)
-  {
-    //bmp.HLine(x1, x2+1, y, MakeRgbPixel(255,255,255));
-    long xleft = min(x1, x2);
-    long xright = max(x1, x2)+1;
-    while(xleft != xright)
-    {
-      bmp.SetPixel(xleft, y, MixColorsInt(2, 10, MakeRgbPixel(255,255,255), bmp.GetPixel(xleft, y)));
-      xleft ++;
-    }
-  }
-};
-
-
 int APIENTRY _tWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPTSTR lpCmdLine, int nCmdShow)
 {
   WNDCLASS wc = {0};
@@ -149,7 +168,15 @@ int APIENTRY _tWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPTSTR lpCm
   MSG msg;
   f.SetRecalcInterval(0.2);
   bool bQuit = false;
-  Test t;// needed to satisfy callback requirements
+  GeomTest<AnimBitmap>* tests[SwapChain<AnimBitmap>::MaxBuffers];// one per buffer, needed to satisfy callback requirements
+  for(long i = 0; i < chain.GetBufferCount(); i ++)
+  {
+    tests[i] = new GeomTest<AnimBitmap>(chain.GetBuffer(i));
+    chain.GetBuffer(i).SetDirtyTracking(true);
+  }
+  presenter.hWnd = hWnd;
+  presenter.bRepaint = true;
+  chain.Start(presenter);
 
   hbr = CreateSolidBrush(RGB(80,80,80));
 
@@ -170,10 +197,18 @@ int APIENTRY _tWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPTSTR lpCm
     else
     {
       f.OnFrame();
-      bmp.BeginDraw();
+      f.OnFrameTimes(chain.GetRenderTime(), chain.GetLatency());
+      AnimBitmap& bmp = chain.BeginFrame();
+      GeomTest<AnimBitmap>& t = *tests[chain.GetBackBufferIndex()];
 
-      std::string s = f.GetAvgFPSString();
-      s.append("fps\r\n");
+      char sz[300];
+      long n = f.FormatAvgFPS(sz, sizeof(sz));
+      n += FPS::Format(sz + n, sizeof(sz) - n, snprintf(sz + n, sizeof(sz) - n, "fps\r\n"));
+      n += f.FormatFrameTimes(sz + n, sizeof(sz) - n);
+      n += FPS::Format(sz + n, sizeof(sz) - n, snprintf(sz + n, sizeof(sz) - n, "\r\n"));
+      n += f.FormatFrameTimeStats(sz + n, sizeof(sz) - n);
+      FPS::Format(sz + n, sizeof(sz) - n, snprintf(sz + n, sizeof(sz) - n, "\r\n"));
+      std::string s = sz;
 
       switch(TestID)
       {
@@ -212,84 +247,62 @@ int APIENTRY _tWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPTSTR lpCm
           long cx = rc.right / 2;
           long cy = rc.bottom / 2;
           // Draw the ellipse.
-          graphics->FillEllipse(bluePen, cx-rout-1, cy-rout-1, rout+rout+1, rout+rout+1);
+          Gdiplus::Graphics graphics(bmp.GetDC());
+          graphics.SetSmoothingMode(Gdiplus::SmoothingModeAntiAlias);
+          graphics.FillEllipse(bluePen, cx-rout-1, cy-rout-1, rout+rout+1, rout+rout+1);
           break;
         }
       case TID_FilledCircleG:
-        {
-          s.append("TID_FilledCircleG");
-          RECT rc;
-          GetClientRect(hWnd, &rc);
-          bmp.Fill(MakeRgbPixel(0,0,0));
-          if(rc.right > 10 && rc.bottom > 10)
-          {
-            long rout = (min(rc.bottom, rc.right) / 2) - 3;
-            long rin = rout / 3;
-            rout = rin;
-            FilledCircleG(rc.right / 2, rc.bottom / 2, rout,
-              &t, Test::DonutAAG_Hline);
-          }
-          break;
-        }
       case TID_FilledCircleAAG:
-        {
-          s.append("TID_FilledCircleAAG");
-          RECT rc;
-          GetClientRect(hWnd, &rc);
-          bmp.Fill(MakeRgbPixel(0,0,0));
-          if(rc.right > 10 && rc.bottom > 10)
-          {
-            long rout = (min(rc.bottom, rc.right) / 2) - 3;
-            long rin = rout / 3;
-            rout = rin;
-            FilledCircleAAG(rc.right / 2, rc.bottom / 2, rout,
-              &t, Test::DonutAAG_Hline,
-              &t, Test::DonutAA2_SetAlphaPixel);
-          }
-          break;
-        }
       case TID_DonutG:
+      case TID_DonutAAG:
+      case TID_DonutAABands:
+      case TID_FilledEllipseG:
+      case TID_FilledEllipseAAG:
+      case TID_EllipseRingG:
+      case TID_DonutAAGClipped:
+      case TID_LineG:
+      case TID_LineAAG:
+      case TID_ThickLineAAG:
+      case TID_FilledCircleAARows:
+      case TID_DonutAARows:
+      case TID_CircleGridAAG:
+      case TID_DrawCirclesAA:
+      case TID_ScanlineCirclesAA:
+      case TID_MaskCompositeAA:
+      case TID_StampCirclesAA:
         {
-          s.append("TID_DonutG");
+          s.append(GetGeomTestName(TestID));
           RECT rc;
           GetClientRect(hWnd, &rc);
-          bmp.Fill(MakeRgbPixel(0,0,0));
           if(rc.right > 10 && rc.bottom > 10)
           {
             long rout = (min(rc.bottom, rc.right) / 2) - 3;
             long rin = rout / 3;
-            DonutG(rc.right / 2, rc.bottom / 2, rin, rout-rin,
-              &t, Test::DonutAAG_Hline);
+            DrawGeomTest(TestID, bmp, t, rc.right / 2, rc.bottom / 2, rin, rin, rout);
           }
-          break;
-        }
-      case TID_DonutAAG:
-        {
-          s.append("TID_DonutAAG");
-          RECT rc;
-          GetClientRect(hWnd, &rc);
-          bmp.Fill(MakeRgbPixel(0,0,0));
-          if(rc.right > 10 && rc.bottom > 10)
+          else
           {
-            long rout = (min(rc.bottom, rc.right) / 2) - 3;
-            long rin = rout / 3;
-            DonutAAG(rc.right / 2, rc.bottom / 2, rin, rout-rin,
-              &t, Test::DonutAAG_Hline,
-              &t, Test::DonutAA2_SetAlphaPixel);
+            bmp.Fill(MakeRgbPixel(0,0,0));
           }
           break;
         }
       }
 
-      bmp.Commit();
       bmp._DrawText(s.c_str(), 0, 0);
-      HDC h = GetDC(hWnd);
-      bmp.Blit(h, 0, 0);
-      ReleaseDC(hWnd, h);
+      chain.EndFrame();
+      GEOM_PROFILE_FRAME(static_cast<long long>(bmp.GetWidth()) * bmp.GetHeight());
     }
   }
 
-  if(graphics) delete graphics;
+  chain.Stop();
+  for(long i = 0; i < chain.GetBufferCount(); i ++)
+  {
+    delete tests[i];
+  }
+#if GEOM_PROFILE
+  Profiler::WriteChromeTrace("geomtrace.json");
+#endif
   if(bluePen) delete bluePen;
 
   DeleteObject(hbr);
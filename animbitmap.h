@@ -3,7 +3,9 @@
   This is a class for "animated bitmaps".  Basically the idea is that you get easy low level
   access do a DIB and its meant to be drawn in frames.
 
-  This is only meant for SCREEN purposes.
+  This is only meant for SCREEN purposes.  The drawing primitives themselves live in PixelBuffer;
+  see SoftBitmap for the same thing without GDI.  With dirty tracking on (see PixelBuffer), use
+  BlitDirty() to only send what changed; text drawn with _DrawText() is tracked too.
 */
 
 
@@ -12,19 +14,14 @@
 
 #include <windows.h>
 #include "blob.h"
-#include "colorframework.h"
+#include "pixelbuffer.h"
 
-using namespace Colors;
 
-
-class AnimBitmap
+class AnimBitmap : public PixelBuffer
 {
 public:
   AnimBitmap() :
-    m_y(0),
-    m_x(0),
-    m_bmp(0),
-    m_pbuf(0)
+    m_bmp(0)
   {
     // store our offscreen hdc
     HDC hscreen = ::GetDC(0);
@@ -46,16 +43,6 @@ public:
     return CSize(m_x, m_y);
   }
 
-  long GetWidth() const
-  {
-    return m_x;
-  }
-
-  long GetHeight() const
-  {
-    return m_y;
-  }
-
   // MUST be called at least once.  This will allocate the bmp object.
   bool SetSize(long x, long y)
   {
@@ -84,22 +71,30 @@ public:
       bi.bmiHeader.biWidth = max(x,1);
       bi.bmiHeader.biHeight = -(max(y,1));
 
-      m_bmp = CreateDIBSection(m_offscreen, &bi, DIB_RGB_COLORS, (void**)&m_pbuf, 0, 0);
+      RgbPixel* pbuf = 0;
+      m_bmp = CreateDIBSection(m_offscreen, &bi, DIB_RGB_COLORS, (void**)&pbuf, 0, 0);
       bi.bmiHeader.biHeight = (max(y,1));
       if(m_bmp)
       {
         r = true;
-        m_x = bi.bmiHeader.biWidth;
-        m_y = bi.bmiHeader.biHeight;
+        // 32bpp DIB rows are never padded, so pitch == width.
+        Attach(pbuf, bi.bmiHeader.biWidth, bi.bmiHeader.biHeight, bi.bmiHeader.biWidth);
         SelectObject(m_offscreen, m_bmp);
       }
+      else
+      {
+        Attach(0, 0, 0, 0);
+      }
     }
     return r;
   }
 
-  // commits the changes
+  // commits the changes.  GDI batches up drawing per thread, so this has to happen before another
+  // thread (see swapchain.h) touches the bitmap.
   bool Commit()
   {
+    GEOM_ZONE("AnimBitmap::Commit");
+    GdiFlush();
     return true;
   }
 
@@ -114,99 +109,6 @@ public:
     return m_offscreen;
   }
 
-  // no boundschecking for speed.
-  void SetPixel(long x, long y, RgbPixel c)
-  {
-    ATLASSERT(x >= 0);
-    ATLASSERT(y >= 0);
-    ATLASSERT(y < m_y);
-    ATLASSERT(x < m_x);
-    //y = m_y - y;
-    m_pbuf[x + (y * m_x)] = c;
-  }
-
-  // xright is NOT drawn.
-  void HLine(long x1, long x2, long y, RgbPixel c)
-  {
-    long xleft = min(x1, x2);
-    long xright = max(x1, x2);
-    RgbPixel* pbuf = &m_pbuf[(y * m_x) + xleft];
-    while(xleft != xright)
-    {
-      *pbuf = c;
-      pbuf ++;
-      xleft ++;
-    }
-  }
-
-  void VLine(long x, long y1, long y2, RgbPixel c)
-  {
-    long ytop = min(y1, y2);
-    long ybottom = max(y1, y2);
-    RgbPixel* pbuf = &m_pbuf[(ytop * m_x) + x];
-    while(ytop != ybottom)
-    {
-      *pbuf = c;
-      pbuf += m_x;
-      ytop ++;
-    }
-  }
-
-  // b and r are not drawn
-  void Rect(long l, long t, long r, long b, RgbPixel c)
-  {
-    RgbPixel* pbuf = &m_pbuf[(t * m_x) + l];
-    long h = r - l;// horizontal size
-    // fill downwards
-    while(t != b)
-    {
-      // draw a horizontal line
-      for(long i = 0; i < h; i ++)
-      {
-        pbuf[i] = c;
-      }
-      pbuf += m_x;
-      t ++;
-    }
-  }
-
-  bool SetPixelSafe(long x, long y, RgbPixel c)
-  {
-    bool r = false;
-    if(x > 0 && y > 0 && x < m_x && y < m_y)
-    {
-      m_pbuf[x + (y * m_x)] = c;
-      r = true;
-    }
-    return r;
-  }
-
-  RgbPixel GetPixel(long x, long y)
-  {
-    return m_pbuf[x + (y * m_x)];
-  }
-
-  bool GetPixelSafe(RgbPixel& out, long x, long y)
-  {
-    bool r = false;
-    if(x > 0 && y > 0 && x < m_x && y < m_y)
-    {
-      out = m_pbuf[x + (y * m_x)];
-      r = true;
-    }
-    return r;
-  }
-
-  void Fill(RgbPixel c)
-  {
-    RgbPixel* pDest = m_pbuf;
-    long n = m_x * m_y;
-    for(long i = 0; i < n; i ++)
-    {
-      pDest[i] = c;
-    }
-  }
-
   bool StretchBlit(AnimBitmap& dest, long destx, long desty, long destw, long desth, long srcx, long srcy, long srcw, long srch)
   {
     int r = StretchBlt(
@@ -229,10 +131,31 @@ public:
 
   bool Blit(HDC hDest, long x, long y)
   {
+    GEOM_ZONE("AnimBitmap::Blit");
     int r = BitBlt(hDest, x, y, x + m_x, y + m_y, m_offscreen, 0, 0, SRCCOPY);
     return r != 0;
   }
 
+  // only what changed since the last BlitDirty(), see PixelBuffer::GetDirtyRects().  the whole
+  // thing when dirty tracking is off.
+  bool BlitDirty(HDC hDest, long x, long y)
+  {
+    GEOM_ZONE("AnimBitmap::BlitDirty");
+    bool r = true;
+    ClipRect rects[MaxDirtyRects];
+    long n = GetDirtyRects(rects, MaxDirtyRects);
+    for(long i = 0; i < n; i ++)
+    {
+      const ClipRect& rc = rects[i];
+      if(!BitBlt(hDest, x + rc.left, y + rc.top, rc.right - rc.left, rc.bottom - rc.top, m_offscreen, rc.left, rc.top, SRCCOPY))
+      {
+        r = false;
+      }
+    }
+    MarkPresented();
+    return r;
+  }
+
   bool Blit(AnimBitmap& dest, long x, long y)
   {
     int r = BitBlt(dest.m_offscreen, x, y, x + m_x, y + m_y, m_offscreen, 0, 0, SRCCOPY);
@@ -242,15 +165,18 @@ public:
   bool _DrawText(const char* s, long x, long y)
   {
     CRect rc(x, y, m_x, m_y);
+    if(GetDirtyTracking())
+    {
+      CRect rcText(rc);
+      DrawText(m_offscreen, s, static_cast<int>(strlen(s)), &rcText, DT_NOCLIP | DT_CALCRECT);
+      AddDirtyRect(rcText.left, rcText.top, rcText.right, rcText.bottom);
+    }
     DrawText(m_offscreen, s, static_cast<int>(strlen(s)), &rc, DT_NOCLIP);
     return true;
   }
 
 private:
-  long m_x;
-  long m_y;
   HDC m_offscreen;
   HBITMAP m_bmp;
-  RgbPixel* m_pbuf;
 };
 
@@ -7,18 +7,39 @@
 
   2004-07-09 carlc
     - fixed realloc bug... it was supposed to return true if no allocation needed to happen
+
+  2026-10-17
+    - no longer needs windows.h; memory comes from the traits (AlignedAlloc() by default).
+    - TAlignment: heap memory now comes from AlignedAlloc() and is aligned to that, and so is
+      the static buffer (which is why that's capped at 64).  Realloc() is alloc + copy + free.
+    - fixed Realloc() only copying TStaticBufferSize BYTES out of the static buffer.
+    - the static buffer is down to 1 element (never used) when TStaticBufferSupport is false,
+      instead of TStaticBufferSize.
+    - can be moved and swapped; copying is not allowed anymore (it used to copy the pointer and
+      free it twice).
+    - the traits say where the memory comes from too: Alloc() / Free().  see frame_blob_traits
+      in framearena.h for scratch memory.
+    - GetNewSize() gets sizeof(Tel) too, so traits can round to bytes.  more traits to pick
+      from: exact_blob_traits, pow2_blob_traits, page_blob_traits and hugepage_blob_traits.
 */
 
 #pragma once
 
-#include <windows.h>
+#include <utility>
+#include "platform.h"
+
+
+// handy values for Blob's TAlignment
+const size_t BlobDefaultAlignment = 16;// SSE
+const size_t BlobCacheLineAlignment = 64;
+const size_t BlobPageAlignment = 4096;
 
 
 class default_blob_traits
 {
 public:
   // return the new size, in elements
-  static long GetNewSize(long current_size, long requested_size)
+  static long GetNewSize(long current_size, long requested_size, size_t /*element_size*/)
   {
     if(!current_size)
     {
@@ -32,6 +53,101 @@ public:
     }
     return current_size;
   }
+
+  // where the memory comes from.  alignment is a power of 2.
+  static void* Alloc(size_t bytes, size_t alignment)
+  {
+    return AlignedAlloc(bytes, alignment);
+  }
+
+  static void Free(void* p)
+  {
+    AlignedFree(p);
+  }
+};
+
+// exactly what was asked for, no slack.  for buffers that get sized once.
+class exact_blob_traits : public default_blob_traits
+{
+public:
+  static long GetNewSize(long /*current_size*/, long requested_size, size_t /*element_size*/)
+  {
+    return requested_size;
+  }
+};
+
+// the next power of 2, so a growing buffer goes through a few predictable sizes.
+class pow2_blob_traits : public default_blob_traits
+{
+public:
+  static long GetNewSize(long /*current_size*/, long requested_size, size_t /*element_size*/)
+  {
+    long r = 1;
+    while((r < requested_size) && (r < (1L << 30)))
+    {
+      r <<= 1;
+    }
+    return r < requested_size ? requested_size : r;
+  }
+};
+
+// grows like the default, but in whole pages, and the memory starts on a page.
+class page_blob_traits : public default_blob_traits
+{
+public:
+  static long GetNewSize(long current_size, long requested_size, size_t element_size)
+  {
+    long n = default_blob_traits::GetNewSize(current_size, requested_size, element_size);
+    return RoundUp(n, element_size, PageSize);
+  }
+
+  static void* Alloc(size_t bytes, size_t alignment)
+  {
+    return AlignedAlloc(bytes, alignment > PageSize ? alignment : PageSize);
+  }
+
+protected:
+  // n elements, rounded up so they fill whole "unit"s of bytes
+  static long RoundUp(long n, size_t element_size, size_t unit)
+  {
+    size_t bytes = ((static_cast<size_t>(n) * element_size + unit - 1) / unit) * unit;
+    return static_cast<long>(bytes / element_size);
+  }
+};
+
+// for the big stuff (framebuffers, accumulation buffers).  anything HugePageSize or bigger is
+// rounded up to and aligned on huge pages, and the OS is asked to back it with them (transparent
+// huge pages on linux), so walking it takes far fewer TLB misses.  smaller is page_blob_traits.
+class hugepage_blob_traits : public page_blob_traits
+{
+public:
+  static long GetNewSize(long current_size, long requested_size, size_t element_size)
+  {
+    long n = page_blob_traits::GetNewSize(current_size, requested_size, element_size);
+    if(static_cast<size_t>(n) * element_size >= HugePageSize)
+    {
+      n = RoundUp(n, element_size, HugePageSize);
+    }
+    return n;
+  }
+
+  static void* Alloc(size_t bytes, size_t alignment)
+  {
+    void* r = 0;
+    if(bytes >= HugePageSize)
+    {
+      r = AlignedAlloc(bytes, alignment > HugePageSize ? alignment : HugePageSize);
+      if(r)
+      {
+        AdviseHugePages(r, bytes);
+      }
+    }
+    else
+    {
+      r = page_blob_traits::Alloc(bytes, alignment);
+    }
+    return r;
+  }
 };
 
 // manages a simple memory blob.
@@ -40,20 +156,35 @@ public:
 //
 // if the class is "not lockable" that means in exchange for removing all the "lockable" checks (for performance), this class
 // will allow direct access to the buffer via GetLockedBuffer()).
-template<typename Tel, bool TLockable = true, bool TStaticBufferSupport = true, typename Ttraits = default_blob_traits, long TStaticBufferSize = 4096>
+//
+// the buffer starts on a TAlignment byte boundary (a power of 2).  Tel is raw memory to Blob: it
+// is moved around with memcpy and never constructed, so keep it to plain types.
+template<typename Tel, bool TLockable = true, bool TStaticBufferSupport = true, typename Ttraits = default_blob_traits, long TStaticBufferSize = 4096, size_t TAlignment = BlobDefaultAlignment>
 class Blob
 {
 public:
 
   typedef Tel _El;
   typedef Ttraits _Traits;
+  static const size_t Alignment = TAlignment;
+
+  static_assert((TAlignment & (TAlignment - 1)) == 0, "Blob alignment must be a power of 2");
+  static_assert(!TStaticBufferSupport || TAlignment <= 64, "turn off the static buffer for alignments over 64");
 
   Blob() :
+    m_size(TStaticBufferSupport ? TStaticBufferSize : 0),
     m_p(TStaticBufferSupport ? m_StaticBuffer : 0),
+    m_locked(false)
+  {
+  }
+
+  // takes rhs's heap memory, or copies its static buffer.  rhs ends up freed.
+  Blob(Blob&& rhs) :
     m_size(TStaticBufferSupport ? TStaticBufferSize : 0),
-    m_locked(false),
-    m_hHeap(GetProcessHeap())
+    m_p(TStaticBufferSupport ? m_StaticBuffer : 0),
+    m_locked(false)
   {
+    Take(rhs);
   }
 
   ~Blob()
@@ -61,6 +192,38 @@ public:
     Free();
   }
 
+  // does nothing if either one is locked; neither one loses anything then.
+  Blob& operator=(Blob&& rhs)
+  {
+    if((this != &rhs) && !CurrentlyLocked() && !rhs.CurrentlyLocked())
+    {
+      Free();
+      Take(rhs);
+    }
+    return *this;
+  }
+
+  bool swap(Blob& rhs)
+  {
+    bool r = false;
+    if(!CurrentlyLocked() && !rhs.CurrentlyLocked())
+    {
+      if(!CurrentlyUsingStaticBuffer() && !rhs.CurrentlyUsingStaticBuffer())
+      {
+        std::swap(m_p, rhs.m_p);
+        std::swap(m_size, rhs.m_size);
+      }
+      else
+      {
+        Blob tmp(std::move(rhs));
+        rhs = std::move(*this);
+        *this = std::move(tmp);
+      }
+      r = true;
+    }
+    return r;
+  }
+
   long size() const
   {
     return m_size;
@@ -99,7 +262,7 @@ public:
       {
         if(m_StaticBuffer != m_p)
         {
-          HeapFree(m_hHeap, 0, m_p);
+          RawFree(m_p);
           m_p = m_StaticBuffer;
           m_size = TStaticBufferSize;
         }
@@ -108,7 +271,7 @@ public:
       {
         if(m_p)
         {
-          HeapFree(m_hHeap, 0, m_p);
+          RawFree(m_p);
           m_p = 0;
           m_size = 0;
         }
@@ -129,8 +292,8 @@ public:
         {
           // we need to allocate on the heap.
           Tel* pNew;
-          long nNewSize = Ttraits::GetNewSize(0, n);
-          pNew = static_cast<Tel*>(HeapAlloc(m_hHeap, 0, sizeof(Tel) * nNewSize));
+          long nNewSize = Ttraits::GetNewSize(0, n, sizeof(Tel));
+          pNew = static_cast<Tel*>(RawAlloc(sizeof(Tel) * nNewSize));
           if(pNew)
           {
             m_p = pNew;
@@ -143,8 +306,8 @@ public:
       {
         // we need to allocate on the heap.
         Tel* pNew;
-        long nNewSize = Ttraits::GetNewSize(0, n);
-        pNew = static_cast<Tel*>(HeapAlloc(m_hHeap, 0, sizeof(Tel) * nNewSize));
+        long nNewSize = Ttraits::GetNewSize(0, n, sizeof(Tel));
+        pNew = static_cast<Tel*>(RawAlloc(sizeof(Tel) * nNewSize));
         if(pNew)
         {
           m_p = pNew;
@@ -169,19 +332,19 @@ public:
       else
       {
         // we definitely need to allocate now.
-        long nNewSize = Ttraits::GetNewSize(m_size, n);
+        long nNewSize = Ttraits::GetNewSize(m_size, n, sizeof(Tel));
         Tel* pNew;
 
         if(CurrentlyUsingStaticBuffer() || CompletelyUnallocated())
         {
           // allocate for the first time.
-          pNew = static_cast<Tel*>(HeapAlloc(m_hHeap, 0, sizeof(Tel) * nNewSize));
+          pNew = static_cast<Tel*>(RawAlloc(sizeof(Tel) * nNewSize));
           if(pNew)
           {
             if(CurrentlyUsingStaticBuffer())
             {
               // copy the contents of the static buffer into the new heap memory.
-              CopyMemory(pNew, m_p, TStaticBufferSize);
+              memcpy(pNew, m_p, sizeof(Tel) * TStaticBufferSize);
             }
 
             m_p = pNew;
@@ -193,7 +356,7 @@ public:
         else
         {
           // realloc, because we already have a heap buffer.
-          pNew = static_cast<Tel*>(HeapReAlloc(m_hHeap, 0, m_p, sizeof(Tel) * nNewSize));
+          pNew = static_cast<Tel*>(RawRealloc(m_p, sizeof(Tel) * m_size, sizeof(Tel) * nNewSize));
           if(pNew)
           {
             m_p = pNew;
@@ -276,13 +439,54 @@ public:
   //}
 
 private:
+  static void* RawAlloc(size_t bytes)
+  {
+    return Ttraits::Alloc(bytes, TAlignment);
+  }
+
+  // there's no portable aligned realloc, so it's a copy.  p is left alone if this fails.
+  static void* RawRealloc(void* p, size_t oldbytes, size_t bytes)
+  {
+    void* r = Ttraits::Alloc(bytes, TAlignment);
+    if(r)
+    {
+      memcpy(r, p, oldbytes < bytes ? oldbytes : bytes);
+      Ttraits::Free(p);
+    }
+    return r;
+  }
+
+  static void RawFree(void* p)
+  {
+    Ttraits::Free(p);
+  }
+
+  // the guts of moving; we're freed and unlocked.
+  void Take(Blob& rhs)
+  {
+    if(rhs.CurrentlyUsingStaticBuffer())
+    {
+      memcpy(m_StaticBuffer, rhs.m_StaticBuffer, sizeof(m_StaticBuffer));
+    }
+    else
+    {
+      m_p = rhs.m_p;
+      m_size = rhs.m_size;
+      rhs.m_p = TStaticBufferSupport ? rhs.m_StaticBuffer : 0;
+      rhs.m_size = TStaticBufferSupport ? TStaticBufferSize : 0;
+    }
+    m_locked = rhs.m_locked;
+    rhs.m_locked = false;
+  }
+
+  Blob(const Blob&);
+  Blob& operator=(const Blob&);
+
   long m_size;
   Tel* m_p;
 
   bool m_locked;
 
-  Tel m_StaticBuffer[TStaticBufferSize];
-
-  HANDLE m_hHeap;
+  alignas(!TStaticBufferSupport ? alignof(Tel) : (TAlignment > 64 ? 64 : TAlignment)) Tel m_StaticBuffer[TStaticBufferSupport ? TStaticBufferSize : 1];
 };
 
@@ -0,0 +1,205 @@
+/*
+  Compile-time circle tables for small radii.
+
+  CircleHeights::Init() and CircleHeightsAA::Init() run a bresenham-style loop every time.  Most
+  circles are small, so for radius 0..GEOM_STATIC_CIRCLE_TABLES we generate the exact same tables
+  at compile time (constexpr) and Init() just points at them.  Bigger radii still run the loops.
+
+  #define GEOM_STATIC_CIRCLE_TABLES 0 before including geom.h to turn this off, or to some other
+  max radius to change the size.  It needs C++14 constexpr, so it's off by default for older
+  compilers.  The tables are packed; radius r takes r+2 entries.  At 64 it's about 27KB of
+  read-only data in total.
+
+  The generators below must stay in sync with the Init() loops in geom.h, quirks and all.
+*/
+
+
+#pragma once
+
+
+#ifndef GEOM_STATIC_CIRCLE_TABLES
+#if (__cplusplus >= 201402L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201402L))
+#define GEOM_STATIC_CIRCLE_TABLES 64
+#else
+#define GEOM_STATIC_CIRCLE_TABLES 0
+#endif
+#endif
+
+
+#if GEOM_STATIC_CIRCLE_TABLES > 0
+
+// which kind of table
+const long SCT_Plain = 0;// CircleHeights
+const long SCT_AAOuter = 1;// CircleHeightsAA<false>
+const long SCT_AAInner = 2;// CircleHeightsAA<true>
+
+// heights (and AA values) for every radius from 0 to N.
+template<long N, long TKind>
+struct StaticCircleTableData
+{
+  typedef unsigned short Height_T;
+
+  // where the tables for radius r start.  r takes r+2 entries.
+  static constexpr long Offset(long r)
+  {
+    return (r * (r + 3)) / 2;
+  }
+
+  static const long Size = (N + 1) * (N + 4) / 2;
+
+  Height_T heights[Size];
+  Height_T aavalues[Size];
+  Height_T mark45[N + 1];
+  Height_T aamax[N + 1];
+
+  constexpr StaticCircleTableData() :
+    heights(),
+    aavalues(),
+    mark45(),
+    aamax()
+  {
+    for(long r = 0; r <= N; r ++)
+    {
+      if(TKind == SCT_Plain)
+      {
+        GeneratePlain(r);
+      }
+      else
+      {
+        GenerateAA(r, TKind == SCT_AAInner);
+      }
+    }
+  }
+
+  // out of range writes (radius 0 does some) are dropped.
+  constexpr void Put(Height_T* p, long r, long i, long val)
+  {
+    if(i >= 0 && i < r + 2)
+    {
+      p[Offset(r) + i] = static_cast<Height_T>(val);
+    }
+  }
+
+  // same as CircleHeights::Init()
+  constexpr void GeneratePlain(long radius)
+  {
+    long d = 3 - (2 * radius);
+    long x = 0;
+    long y = radius;
+    long iStart = 0;
+    long iEnd = radius - 1;
+    Put(heights, radius, iStart, radius);
+
+    while(x <= y)
+    {
+      Put(heights, radius, iStart, y - 1);
+
+      if(d < 0)
+      {
+        d += (4 * x) + 6;
+      }
+      else
+      {
+        Put(heights, radius, iEnd, x);
+        iEnd --;
+        y --;
+        d += 4 * (x - y) + 10;
+      }
+
+      x ++;
+      iStart ++;
+    }
+
+    mark45[radius] = static_cast<Height_T>(x);
+  }
+
+  // same as CircleHeightsAA<bInner>::Init()
+  constexpr void GenerateAA(long radius, bool bInner)
+  {
+    long hMinus1 = 0;
+    long hMinus1Squared = 0;
+    long delta = 0;
+    long x = 0;
+    long x2 = 0;
+    long r2 = radius * radius;
+    long h = radius;
+    long iStart = 0;
+    long iEnd = radius;
+    long iAA = 0;
+    long hPlus1 = h + 1;
+    long hPlus1Squared = hPlus1 * hPlus1;
+    long max = 0;
+
+    if(bInner)
+    {
+      hMinus1 = h;
+      hMinus1Squared = hMinus1 * hMinus1;
+      max = static_cast<Height_T>(((radius + 1) * (radius + 1)) - r2);
+    }
+    else
+    {
+      max = static_cast<Height_T>(r2 - ((radius - 1) * (radius - 1)));
+    }
+
+    while(x <= h)
+    {
+      if(bInner)
+      {
+        if((x2 + hMinus1Squared - r2) > 0)
+        {
+          Put(heights, radius, iEnd, x - 1);
+          iEnd --;
+          h --;
+          hMinus1 --;
+          hMinus1Squared = hMinus1 * hMinus1;
+        }
+
+        delta = r2 - (hMinus1Squared + x2);
+        delta = max - delta;
+      }
+      else
+      {
+        if((x2 + hPlus1Squared - r2) >= 0)
+        {
+          Put(heights, radius, iEnd, x - 1);
+          iEnd --;
+          h --;
+          hPlus1 --;
+          hPlus1Squared = hPlus1 * hPlus1;
+        }
+
+        delta = r2 - (hPlus1Squared + x2);
+      }
+
+      if(delta < 0) delta = 0;
+      if(delta > max) delta = max;
+      Put(aavalues, radius, iAA, delta);
+      iAA ++;
+
+      Put(heights, radius, iStart, h);
+      iStart ++;
+
+      x ++;
+      x2 = x * x;
+    }
+
+    mark45[radius] = static_cast<Height_T>(x);
+    aamax[radius] = static_cast<Height_T>(max);
+  }
+};
+
+
+// one read-only instance of each kind of table.
+template<long TKind>
+struct StaticCircleTables
+{
+  typedef StaticCircleTableData<GEOM_STATIC_CIRCLE_TABLES, TKind> Data_T;
+  static const long MaxRadius = GEOM_STATIC_CIRCLE_TABLES;
+  static constexpr Data_T data = Data_T();
+};
+
+template<long TKind>
+constexpr typename StaticCircleTables<TKind>::Data_T StaticCircleTables<TKind>::data;
+
+#endif
+
@@ -18,6 +18,7 @@
 
 #include <string>
 #include <vector>
+#include "platform.h"
 
 
 namespace Colors
@@ -63,10 +64,12 @@ namespace Colors
     return MakeRgbPixelB(static_cast<BYTE>(r), static_cast<BYTE>(g), static_cast<BYTE>(b));
   }
 
+#ifdef _WIN32
   inline COLORREF RgbPixelToCOLORREF(RgbPixel x)
   {
     return RGB(R(x), G(x), B(x));
   }
+#endif
 
   //////////////////////////////////////////////////////////////////////////////////////////
   // Raw single color data storage.  Each colorspace will use these however it wants.  All color
@@ -145,15 +148,31 @@ namespace Colors
 
   //////////////////////////////////////////////////////////////////////////////////////////
   // fill one of these out and pass it to ColorManager::RegisterColorSpace()
+  //
+  // the array procs are optional; they're for colorspaces that can do a whole palette or pixel
+  // field in one tight loop instead of a call per color.  whatever isn't there gets done with the
+  // other kind (a loop over the single-color proc, or the array proc with n = 1), so a colorspace
+  // has to provide at least one of each pair.  always go through ToRGB() / ConvertTo() /
+  // ToRGBArray() / ConvertArray() / ToRGBPlanes() rather than the pointers.
   class ColorSpaceInfo
   {
   public:
     typedef RgbPixel (__stdcall* ToRGBFastProc)(const ColorData&);// proc for QUICKLY converting to pixel format
     typedef ConversionResult (__stdcall* ConvertToProc)(ColorSpaceID, ColorData&);// less speed intensive conversion function
     typedef void (__stdcall* InitNewProc)(ColorData&);// initializes a new color
+    typedef void (__stdcall* ToRGBArrayProc)(const ColorData* src, RgbPixel* dest, size_t n);
+    typedef ConversionResult (__stdcall* ConvertArrayProc)(ColorSpaceID, ColorData* dat, size_t n, ConversionResult* pResults);
+    typedef void (__stdcall* ToRGBPlanesProc)(const Colorant* const* planes, RgbPixel* dest, size_t n);// planes[nColorants]
     typedef std::vector<ColorantInfo> ColorantList;
 
-    ColorSpaceInfo() { }
+    ColorSpaceInfo() :
+      pToRGBFast(0),
+      pConvertTo(0),
+      pInitNew(0),
+      pToRGBArray(0),
+      pConvertArray(0),
+      pToRGBPlanes(0)
+    { }
 
     ColorSpaceInfo(const ColorSpaceInfo& r) :
       id(r.id),
@@ -164,7 +183,10 @@ namespace Colors
       Colorants(r.Colorants),
       pToRGBFast(r.pToRGBFast),
       pConvertTo(r.pConvertTo),
-      pInitNew(r.pInitNew)
+      pInitNew(r.pInitNew),
+      pToRGBArray(r.pToRGBArray),
+      pConvertArray(r.pConvertArray),
+      pToRGBPlanes(r.pToRGBPlanes)
     {
     }
 
@@ -179,9 +201,97 @@ namespace Colors
       pToRGBFast = r.pToRGBFast;
       pConvertTo = r.pConvertTo;
       pInitNew = r.pInitNew;
+      pToRGBArray = r.pToRGBArray;
+      pConvertArray = r.pConvertArray;
+      pToRGBPlanes = r.pToRGBPlanes;
       return *this;
     }
 
+    inline RgbPixel ToRGB(const ColorData& c) const
+    {
+      RgbPixel r;
+      if(pToRGBFast)
+      {
+        r = pToRGBFast(c);
+      }
+      else
+      {
+        pToRGBArray(&c, &r, 1);
+      }
+      return r;
+    }
+
+    inline ConversionResult ConvertTo(ColorSpaceID destid, ColorData& c) const
+    {
+      return pConvertTo ? pConvertTo(destid, c) : pConvertArray(destid, &c, 1, 0);
+    }
+
+    // n colors at once.
+    void ToRGBArray(const ColorData* src, RgbPixel* dest, size_t n) const
+    {
+      if(pToRGBArray)
+      {
+        pToRGBArray(src, dest, n);
+      }
+      else
+      {
+        for(size_t i = 0; i < n; i ++)
+        {
+          dest[i] = pToRGBFast(src[i]);
+        }
+      }
+    }
+
+    // converts all n in place.  returns CR_InGamut if they all were, otherwise the worst result.
+    // pResults (if it isn't 0) gets each color's own result.
+    ConversionResult ConvertArray(ColorSpaceID destid, ColorData* dat, size_t n, ConversionResult* pResults = 0) const
+    {
+      ConversionResult r = CR_InGamut;
+      if(pConvertArray)
+      {
+        r = pConvertArray(destid, dat, n, pResults);
+      }
+      else
+      {
+        for(size_t i = 0; i < n; i ++)
+        {
+          ConversionResult cr = pConvertTo(destid, dat[i]);
+          if(pResults) pResults[i] = cr;
+          if(cr > r) r = cr;
+        }
+      }
+      return r;
+    }
+
+    // the same as ToRGBArray(), but with each colorant in its own array (planes[0] is all the
+    // first colorants, and so on).  only for colorspaces that use colorants.
+    void ToRGBPlanes(const Colorant* const* planes, RgbPixel* dest, size_t n) const
+    {
+      if(pToRGBPlanes)
+      {
+        pToRGBPlanes(planes, dest, n);
+      }
+      else
+      {
+        // gather into ColorData a chunk at a time
+        const size_t Chunk = 64;
+        ColorData tmp[Chunk];
+        for(size_t first = 0; first < n; first += Chunk)
+        {
+          size_t count = (n - first) < Chunk ? (n - first) : Chunk;
+          for(long c = 0; c < nColorants; c ++)
+          {
+            const Colorant* p = planes[c] + first;
+            for(size_t i = 0; i < count; i ++)
+            {
+              tmp[i].m_Colorants[c] = p[i];
+            }
+          }
+          ToRGBArray(tmp, dest + first, count);
+        }
+      }
+    }
+
     ColorSpaceID id;
     long nColorants;
     bool bUsesColorants;
@@ -191,6 +301,9 @@ namespace Colors
     ToRGBFastProc pToRGBFast;
     ConvertToProc pConvertTo;
     InitNewProc pInitNew;
+    ToRGBArrayProc pToRGBArray;// optional
+    ConvertArrayProc pConvertArray;// optional
+    ToRGBPlanesProc pToRGBPlanes;// optional
   };
 
   //////////////////////////////////////////////////////////////////////////////////////////
@@ -210,6 +323,26 @@ namespace Colors
     return MakeRgbPixel(0,0,0);
   }
 
+  inline void __stdcall InvalidToRGBArray(const ColorData* src, RgbPixel* dest, size_t n)
+  {
+    for(size_t i = 0; i < n; i ++)
+    {
+      dest[i] = MakeRgbPixel(0,0,0);
+    }
+  }
+
+  inline ConversionResult __stdcall InvalidConvertArray(ColorSpaceID destid, ColorData* dat, size_t n, ConversionResult* pResults)
+  {
+    if(pResults)
+    {
+      for(size_t i = 0; i < n; i ++)
+      {
+        pResults[i] = CR_ConversionFailed;
+      }
+    }
+    return CR_ConversionFailed;
+  }
+
   inline ColorSpaceInfo InvalidGetInfo()
   {
     ColorSpaceInfo r;
@@ -222,6 +355,8 @@ namespace Colors
     r.pToRGBFast = InvalidToRGBFast;
     r.pConvertTo = InvalidConvertTo;
     r.pInitNew = InvalidInitNew;
+    r.pToRGBArray = InvalidToRGBArray;
+    r.pConvertArray = InvalidConvertArray;
     return r;
   }
 
@@ -232,49 +367,86 @@ namespace Colors
   class ColorManager
   {
   public:
+    // ColorSpaceID is 8 bits, so every possible id has its own slot.
+    static const long MaxColorSpaces = 256;
+
     ColorManager()
     {
+      for(long i = 0; i < MaxColorSpaces; i ++)
+      {
+        ColorSpaces[i] = 0;
+      }
       // initialize with some default crap about CS_Invalid
       RegisterColorSpace(InvalidGetInfo());
     }
 
-    ColorManager(const ColorManager& r) :
-      ColorSpaces(r.ColorSpaces)
+    ColorManager(const ColorManager& r)
     {
+      for(long i = 0; i < MaxColorSpaces; i ++)
+      {
+        ColorSpaces[i] = r.ColorSpaces[i] ? new ColorSpaceInfo(*r.ColorSpaces[i]) : 0;
+      }
     }
 
+    // colorspaces we both have are copied in place, so pointers into this one stay good.
     ColorManager& operator = (const ColorManager& r)
     {
-      ColorSpaces = r.ColorSpaces;
+      if(this != &r)
+      {
+        for(long i = 0; i < MaxColorSpaces; i ++)
+        {
+          if(!r.ColorSpaces[i])
+          {
+            delete ColorSpaces[i];
+            ColorSpaces[i] = 0;
+          }
+          else if(ColorSpaces[i])
+          {
+            *ColorSpaces[i] = *r.ColorSpaces[i];
+          }
+          else
+          {
+            ColorSpaces[i] = new ColorSpaceInfo(*r.ColorSpaces[i]);
+          }
+        }
+      }
       return *this;
     }
 
-    bool RegisterColorSpace(const ColorSpaceInfo& csi)
+    ~ColorManager()
     {
-      // TODO: check to see if the colorspace is already registered, and other validation
-      ColorSpaces.push_back(csi);
-      return true;
+      for(long i = 0; i < MaxColorSpaces; i ++)
+      {
+        delete ColorSpaces[i];
+      }
     }
 
-    ColorSpaceInfo* FindColorSpaceInfo(ColorSpaceID id)
+    // fails if the id is already taken (the first one registered always won anyway).  pointers
+    // from FindColorSpaceInfo() stay good until the manager goes away, no matter what gets
+    // registered after.
+    bool RegisterColorSpace(const ColorSpaceInfo& csi)
     {
-      ColorSpaceInfo* r = 0;
-      // TODO: speed this up
-      ColorSpaceList::iterator it;
-      for(it = ColorSpaces.begin(); it != ColorSpaces.end(); ++it)
+      bool r = false;
+      if(!ColorSpaces[csi.id])
       {
-        if(it->id == id)
-        {
-          r = &(*it);
-          break;
-        }
+        ColorSpaces[csi.id] = new ColorSpaceInfo(csi);
+        r = true;
       }
       return r;
     }
 
+    ColorSpaceInfo* FindColorSpaceInfo(ColorSpaceID id)
+    {
+      return ColorSpaces[id];
+    }
+
+    const ColorSpaceInfo* FindColorSpaceInfo(ColorSpaceID id) const
+    {
+      return ColorSpaces[id];
+    }
+
   private:
-    typedef std::vector<ColorSpaceInfo> ColorSpaceList;
-    ColorSpaceList ColorSpaces;
+    ColorSpaceInfo* ColorSpaces[MaxColorSpaces];// indexed by id; 0 = not registered
   };
 
   //////////////////////////////////////////////////////////////////////////////////////////
@@ -343,7 +515,7 @@ namespace Colors
       ColorSpaceInfo* pNewCSI = m_pManager->FindColorSpaceInfo(dest);
       if(pNewCSI)
       {
-        r = m_pcsi->pConvertTo(dest, m_data);
+        r = m_pcsi->ConvertTo(dest, m_data);
         m_pcsi = pNewCSI;
       }
       return r;
@@ -396,7 +568,7 @@ namespace Colors
 
     inline RgbPixel GetRGBFast() const
     {
-      return m_pcsi->pToRGBFast(m_data);
+      return m_pcsi->ToRGB(m_data);
     }
 
   private:
@@ -0,0 +1,268 @@
+/*
+  An 8 bit coverage mask (A8): one byte per pixel, 0 = empty, 255 = solid.  Rasterize a shape
+  into one of these once, then Composite() it onto any number of bitmaps, in any color, as many
+  times as you want.  It's a quarter of the memory of the RgbPixel version, and compositing
+  goes through the same SIMD coverage kernels as everything else (see pixelkernels.h).
+
+  It's a span sink, so the *Spans / *Rows functions in geom.h can draw straight into it:
+
+    CoverageMask mask;
+    mask.SetSize(2 * r + 2, 2 * r + 2);
+    mask.Clear();
+    FilledCircleAARows(r + 1, r + 1, r, mask.GetClip(), mask);
+    mask.Composite(bmp, x, y, MakeRgbPixel(255, 0, 0));
+
+  Sinks don't clip, so pass GetClip() to anything that draws into it.  The *G functions can use
+  it too, through HLineProc() and AAProc() / AAPixelProc(), which DO clip and scale f / fmax to
+  0-255.
+
+  Overlapping coverage adds up the way two independent shapes would: a + b - a*b.  The mask
+  keeps track of which part of each row has been touched, so Clear() and Composite() only look
+  at that.
+*/
+
+
+#pragma once
+
+
+#include <string.h>
+#include "platform.h"
+#include "pixelbuffer.h"
+#include "spanbuffer.h"
+
+
+class CoverageMask
+{
+public:
+  static const long Alignment = 64;// bytes, same as SoftBitmap
+
+  CoverageMask() :
+    m_x(0),
+    m_y(0),
+    m_pitch(0),
+    m_pbuf(0),
+    m_pLeft(0),
+    m_pRight(0)
+  {
+  }
+
+  ~CoverageMask()
+  {
+    Free();
+  }
+
+  // MUST be called at least once.  The mask is empty after a resize.
+  bool SetSize(long x, long y)
+  {
+    bool r = true;
+
+    if(x < 1) x = 1;
+    if(y < 1) y = 1;
+
+    if((x != m_x) || (y != m_y))
+    {
+      long pitch = (x + Alignment - 1) & ~(Alignment - 1);
+      BYTE* pNew = static_cast<BYTE*>(AlignedAlloc(pitch * y, Alignment));
+      long* pLeft = static_cast<long*>(AlignedAlloc(sizeof(long) * y, sizeof(long)));
+      long* pRight = static_cast<long*>(AlignedAlloc(sizeof(long) * y, sizeof(long)));
+
+      r = false;
+      if(pNew && pLeft && pRight)
+      {
+        Free();
+        m_pbuf = pNew;
+        m_pLeft = pLeft;
+        m_pRight = pRight;
+        m_x = x;
+        m_y = y;
+        m_pitch = pitch;
+        memset(m_pbuf, 0, m_pitch * m_y);
+        ResetExtents();
+        r = true;
+      }
+      else
+      {
+        if(pNew) AlignedFree(pNew);
+        if(pLeft) AlignedFree(pLeft);
+        if(pRight) AlignedFree(pRight);
+      }
+    }
+    return r;
+  }
+
+  long GetWidth() const
+  {
+    return m_x;
+  }
+
+  long GetHeight() const
+  {
+    return m_y;
+  }
+
+  // distance between rows, in bytes.
+  long GetPitch() const
+  {
+    return m_pitch;
+  }
+
+  // the whole mask, for the *Spans functions.
+  ClipRect GetClip() const
+  {
+    return MakeClipRect(0, 0, m_x, m_y);
+  }
+
+  BYTE* GetRow(long y)
+  {
+    return m_pbuf + (y * m_pitch);
+  }
+
+  const BYTE* GetRow(long y) const
+  {
+    return m_pbuf + (y * m_pitch);
+  }
+
+  BYTE GetCoverage(long x, long y) const
+  {
+    return m_pbuf[x + (y * m_pitch)];
+  }
+
+  // the part of row y that isn't empty is GetLeft(y) <= x < GetRight(y).  (maybe a little more.)
+  long GetLeft(long y) const
+  {
+    return m_pLeft[y];
+  }
+
+  long GetRight(long y) const
+  {
+    return m_pRight[y];
+  }
+
+  // back to all 0.  only touches the rows that have something in them.
+  void Clear()
+  {
+    for(long y = 0; y < m_y; y ++)
+    {
+      if(m_pLeft[y] < m_pRight[y])
+      {
+        memset(GetRow(y) + m_pLeft[y], 0, m_pRight[y] - m_pLeft[y]);
+      }
+    }
+    ResetExtents();
+  }
+
+  // span sink: x1 through x2, both inclusive, all solid.  NOT clipped.
+  inline void AddSpan(long x1, long x2, long y)
+  {
+    memset(GetRow(y) + x1, 255, x2 + 1 - x1);
+    Touch(x1, x2 + 1, y);
+  }
+
+  // span sink: one pixel, c is 0-255.  NOT clipped.
+  inline void AddCoverage(long x, long y, BYTE c)
+  {
+    BYTE* p = GetRow(y) + x;
+    // p + c - p*c, rounded, in 0-255
+    long t = ((255 - *p) * c) + 128;
+    *p = static_cast<BYTE>(*p + ((t + (t >> 8)) >> 8));
+    Touch(x, x + 1, y);
+  }
+
+  // callbacks for the *G functions.  these clip, unlike the sink methods above.
+  void HLineProc(long x1, long x2, long y)
+  {
+    long xleft = x1 < x2 ? x1 : x2;
+    long xright = x1 < x2 ? x2 : x1;
+    if(y >= 0 && y < m_y)
+    {
+      if(xleft < 0) xleft = 0;
+      if(xright >= m_x) xright = m_x - 1;
+      if(xleft <= xright)
+      {
+        AddSpan(xleft, xright, y);
+      }
+    }
+  }
+
+  // the 4 way mirrored AA callback of FilledCircleAAG(), DonutAAG() and friends.
+  void AAProc(long cx, long cy, long x, long y, long f, long fmax)
+  {
+    AAPixelProc(cx + x, cy + y, f, fmax);
+    AAPixelProc(cx + x, cy - y - 1, f, fmax);
+    AAPixelProc(cx - x - 1, cy + y, f, fmax);
+    AAPixelProc(cx - x - 1, cy - y - 1, f, fmax);
+  }
+
+  // the one pixel AA callback of the clipped *G functions and the lines.
+  void AAPixelProc(long x, long y, long f, long fmax)
+  {
+    if(x >= 0 && y >= 0 && x < m_x && y < m_y && fmax > 0)
+    {
+      long c = ((f * 255) + (fmax >> 1)) / fmax;
+      AddCoverage(x, y, static_cast<BYTE>(c > 255 ? 255 : (c < 0 ? 0 : c)));
+    }
+  }
+
+  /*
+    Blends c onto dest through the mask, with the mask's top left corner at (x, y) in dest.
+    Clipped to dest; only the touched part of each row is read.  Returns how many pixels were
+    blended.
+  */
+  long Composite(PixelBuffer& dest, long x, long y, RgbPixel c) const
+  {
+    long n = 0;
+    long y0 = y < 0 ? -y : 0;
+    long y1 = (dest.GetHeight() - y) < m_y ? (dest.GetHeight() - y) : m_y;
+
+    for(long my = y0; my < y1; my ++)
+    {
+      long left = m_pLeft[my];
+      long right = m_pRight[my];
+      if(x + left < 0) left = -x;
+      if(x + right > dest.GetWidth()) right = dest.GetWidth() - x;
+      if(left < right)
+      {
+        dest.BlendCoverageRow(x + left, y + my, GetRow(my) + left, right - left, c);
+        n += right - left;
+      }
+    }
+    return n;
+  }
+
+private:
+  inline void Touch(long x1, long x2, long y)
+  {
+    if(x1 < m_pLeft[y]) m_pLeft[y] = x1;
+    if(x2 > m_pRight[y]) m_pRight[y] = x2;
+  }
+
+  void ResetExtents()
+  {
+    for(long y = 0; y < m_y; y ++)
+    {
+      m_pLeft[y] = m_x;
+      m_pRight[y] = 0;
+    }
+  }
+
+  void Free()
+  {
+    if(m_pbuf) AlignedFree(m_pbuf);
+    if(m_pLeft) AlignedFree(m_pLeft);
+    if(m_pRight) AlignedFree(m_pRight);
+    m_pbuf = 0;
+    m_pLeft = 0;
+    m_pRight = 0;
+  }
+
+  CoverageMask(const CoverageMask&);
+  CoverageMask& operator=(const CoverageMask&);
+
+  long m_x;
+  long m_y;
+  long m_pitch;
+  BYTE* m_pbuf;
+  long* m_pLeft;// per row, the touched part is m_pLeft[y] <= x < m_pRight[y]
+  long* m_pRight;
+};
+
@@ -3,7 +3,7 @@
   class to automate doing frames per second functionality.
 
   FPS fps;
-  
+
   while(each frame)
   {
     // do your frame stuff...
@@ -14,68 +14,222 @@
   }
 
   call SetRecalcInterval() if you want to refresh the fps less frequently.
+
+  When the frames go through a SwapChain, hand over its times each frame too, and you get them
+  averaged over the same interval:
+
+    fps.OnFrameTimes(chain.GetRenderTime(), chain.GetLatency());
+    display(fps.GetRenderTime(), fps.GetLatency());
+
+  2026-10-17
+    - std::chrono::steady_clock instead of QueryPerformanceCounter, so no windows.h.
+    - the last HistorySize frame times are kept, for the spread and not just the average:
+
+        FrameTimeStats st;
+        fps.GetFrameTimeStats(st);// min, mean, p50, p95, p99, max, jitter
+
+    - every GetXXXString() has a FormatXXX(buf, size) that writes into your buffer instead of
+      allocating a std::string, for calling every frame.
 */
 
 #pragma once
 
-#include <windows.h>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
 #include <string>
 
 
+// frame times over the history, in seconds.  jitter is the average change from one frame to the
+// next, so a steady 30fps has none and alternating 10ms / 40ms frames have a lot.
+struct FrameTimeStats
+{
+  long count;// how many frames this is from
+  double min;
+  double mean;
+  double p50;
+  double p95;
+  double p99;
+  double max;
+  double jitter;
+};
+
+
 class FPS
 {
 public:
+  static const long HistorySize = 512;// frames
+
   FPS() :
     m_fps(0),
-    m_lasttick(0),
-    m_interval(0),
     m_frames(0),
+    m_interval(0),
+    m_lasttick(0),
     m_totallasttick(0),
-    m_totalframes(0)
+    m_totalframes(0),
+    m_render(0),
+    m_latency(0),
+    m_rendersum(0),
+    m_latencysum(0),
+    m_timedframes(0),
+    m_framelasttick(0),
+    m_nHistory(0),
+    m_nextHistory(0)
   {
-    LARGE_INTEGER lifreq;
-    QueryPerformanceFrequency(&lifreq);
-    m_freq = (double)lifreq.QuadPart;
   }
 
   void SetRecalcInterval(double secs)
   {
-    m_interval = (LONGLONG)(secs * m_freq);
+    m_interval = (long long)(secs * 1e9);
   }
 
   inline void OnFrame()
   {
-    LONGLONG ct = GetCurrentTick();
-    LONGLONG delta = ct - m_lasttick;
+    long long ct = GetCurrentTick();
+    long long delta = ct - m_lasttick;
     m_frames ++;
     m_totalframes ++;
 
+    if(m_framelasttick)
+    {
+      m_history[m_nextHistory] = ct - m_framelasttick;
+      m_nextHistory = (m_nextHistory + 1) % HistorySize;
+      if(m_nHistory < HistorySize)
+      {
+        m_nHistory ++;
+      }
+    }
+    m_framelasttick = ct;
+
     if(delta > m_interval)
     {
       // recalc fps and reset m_frames
       m_fps = (double)m_frames / TicksToSeconds(delta);
       m_frames = 0;
       m_lasttick = ct;
+      if(m_timedframes)
+      {
+        m_render = m_rendersum / m_timedframes;
+        m_latency = m_latencysum / m_timedframes;
+        m_rendersum = 0;
+        m_latencysum = 0;
+        m_timedframes = 0;
+      }
     }
   }
 
+  // render = time spent drawing the frame, latency = from starting it to it being shown, in secs.
+  inline void OnFrameTimes(double render, double latency)
+  {
+    m_rendersum += render;
+    m_latencysum += latency;
+    m_timedframes ++;
+  }
+
+  inline double GetRenderTime() const
+  {
+    return m_render;
+  }
+
+  inline double GetLatency() const
+  {
+    return m_latency;
+  }
+
+  // "render 1.23ms latency 4.56ms"
+  inline long FormatFrameTimes(char* sz, size_t size) const
+  {
+    return Format(sz, size, snprintf(sz, size, "render %4.2fms latency %4.2fms", m_render * 1000.0, m_latency * 1000.0));
+  }
+
+  inline std::string GetFrameTimesString() const
+  {
+    char sz[100];
+    FormatFrameTimes(sz, sizeof(sz));
+    return std::string(sz);
+  }
+
+  // over the last HistorySize frames (fewer at the start).  returns false (and all zeros) until
+  // there are 2 frames.  doesn't allocate.
+  bool GetFrameTimeStats(FrameTimeStats& st) const
+  {
+    bool r = false;
+    memset(&st, 0, sizeof(st));
+    if(m_nHistory)
+    {
+      // oldest first, so jitter goes in frame order
+      long long sorted[HistorySize];
+      long first = (m_nextHistory + HistorySize - m_nHistory) % HistorySize;
+      long long sum = 0;
+      long long jitter = 0;
+      for(long i = 0; i < m_nHistory; i ++)
+      {
+        sorted[i] = m_history[(first + i) % HistorySize];
+        sum += sorted[i];
+        if(i)
+        {
+          long long d = sorted[i] - sorted[i - 1];
+          jitter += d < 0 ? -d : d;
+        }
+      }
+      std::sort(sorted, sorted + m_nHistory);
+
+      st.count = m_nHistory;
+      st.min = TicksToSeconds(sorted[0]);
+      st.mean = TicksToSeconds(sum) / m_nHistory;
+      st.p50 = TicksToSeconds(Percentile(sorted, m_nHistory, 50));
+      st.p95 = TicksToSeconds(Percentile(sorted, m_nHistory, 95));
+      st.p99 = TicksToSeconds(Percentile(sorted, m_nHistory, 99));
+      st.max = TicksToSeconds(sorted[m_nHistory - 1]);
+      st.jitter = m_nHistory > 1 ? TicksToSeconds(jitter) / (m_nHistory - 1) : 0;
+      r = true;
+    }
+    return r;
+  }
+
+  // "frame ms min 16.1 avg 16.7 p50 16.6 p95 17.9 p99 21.0 max 33.4 jitter 0.42"
+  inline long FormatFrameTimeStats(char* sz, size_t size) const
+  {
+    FrameTimeStats st;
+    GetFrameTimeStats(st);
+    return Format(sz, size, snprintf(sz, size, "frame ms min %.1f avg %.1f p50 %.1f p95 %.1f p99 %.1f max %.1f jitter %.2f",
+      st.min * 1000.0, st.mean * 1000.0, st.p50 * 1000.0, st.p95 * 1000.0, st.p99 * 1000.0, st.max * 1000.0, st.jitter * 1000.0));
+  }
+
+  inline std::string GetFrameTimeStatsString() const
+  {
+    char sz[200];
+    FormatFrameTimeStats(sz, sizeof(sz));
+    return std::string(sz);
+  }
+
+  // forgets the frame times too.
   inline void ResetTotal()
   {
     m_totalframes = 0;
     m_totallasttick = GetCurrentTick();
+    m_framelasttick = 0;
+    m_nHistory = 0;
+    m_nextHistory = 0;
   }
 
   inline double GetAvgFPS() const
   {
-    LONGLONG ct = GetCurrentTick();
-    LONGLONG delta = ct - m_totallasttick;
+    long long ct = GetCurrentTick();
+    long long delta = ct - m_totallasttick;
     return (double)m_totalframes / TicksToSeconds(delta);
   }
 
+  inline long FormatAvgFPS(char* sz, size_t size) const
+  {
+    return Format(sz, size, snprintf(sz, size, "%4.2f", GetAvgFPS()));
+  }
+
   inline std::string GetAvgFPSString() const
   {
     char sz[100];
-    sprintf(sz, "%4.2f", GetAvgFPS());
+    FormatAvgFPS(sz, sizeof(sz));
     return std::string(sz);
   }
 
@@ -84,34 +238,69 @@ public:
     return m_fps;
   }
 
+  inline long FormatFPS(char* sz, size_t size) const
+  {
+    return Format(sz, size, snprintf(sz, size, "%4.2f", m_fps));
+  }
+
   inline std::string GetFPSString() const
   {
     char sz[100];
-    sprintf(sz, "%4.2f", m_fps);
+    FormatFPS(sz, sizeof(sz));
     return std::string(sz);
   }
 
-private:
+  // nanoseconds on a clock that never goes backwards
+  inline static long long GetCurrentTick()
+  {
+    return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
 
-  inline double TicksToSeconds(LONGLONG n) const
+  inline static double TicksToSeconds(long long n)
   {
-    return (double)n / m_freq;
+    return (double)n / 1e9;
   }
 
-  inline static LONGLONG GetCurrentTick()
+  // snprintf's return value -> the # of chars actually in sz.  it's always terminated.
+  inline static long Format(char* sz, size_t size, int n)
+  {
+    long r = 0;
+    if(size)
+    {
+      r = n < 0 ? 0 : ((size_t)n >= size ? (long)size - 1 : n);
+      sz[r] = 0;
+    }
+    return r;
+  }
+
+private:
+
+  // nearest rank, from sorted
+  inline static long long Percentile(const long long* sorted, long n, long pct)
   {
-    LARGE_INTEGER li;
-    QueryPerformanceCounter(&li);
-    return li.QuadPart;
+    long i = (n * pct + 99) / 100 - 1;
+    return sorted[i < 0 ? 0 : i];
   }
+
   double m_fps;
-  double m_freq;// units per second
   long m_frames;// # of frames since last recalc
-  LONGLONG m_interval;// how many units until we refresh m_fps
-  LONGLONG m_lasttick;
+  long long m_interval;// how many ns until we refresh m_fps
+  long long m_lasttick;
+
+  long long m_totallasttick;
+  long long m_totalframes;
+
+  double m_render;// averages as of the last recalc
+  double m_latency;
+  double m_rendersum;// since the last recalc
+  double m_latencysum;
+  long m_timedframes;
 
-  LONGLONG m_totallasttick;
-  LONGLONG m_totalframes;
+  long long m_framelasttick;// the last OnFrame(), or 0 before the first
+  long long m_history[HistorySize];// frame times in ns, a ring
+  long m_nHistory;// how many of m_history are filled in
+  long m_nextHistory;// where the next one goes
 };
 
 
@@ -122,45 +311,40 @@ class Timer
 public:
   Timer() :
     m_lasttick(0),
-    m_lasttick2(0)
+    m_lasttick2(0),
+    m_delta(0)
   {
-    LARGE_INTEGER lifreq;
-    QueryPerformanceFrequency(&lifreq);
-    m_freq = (double)lifreq.QuadPart;
   }
 
   // call this to "tick" the timer... the time between the previous tick and this one is now stored.
-  inline Tick()
+  inline void Tick()
   {
-    LARGE_INTEGER li;
-    QueryPerformanceCounter(&li);
     m_lasttick2 = m_lasttick;
-    m_lasttick = li.QuadPart;
+    m_lasttick = FPS::GetCurrentTick();
     m_delta = m_lasttick - m_lasttick2;
   }
 
   inline double GetLastDelta() const
   {
-    return TicksToSeconds(m_delta);
+    return FPS::TicksToSeconds(m_delta);
+  }
+
+  inline long FormatLastDelta(char* sz, size_t size) const
+  {
+    return FPS::Format(sz, size, snprintf(sz, size, "%4.2f", GetLastDelta()));
   }
 
   inline std::string GetLastDeltaString() const
   {
     char sz[100];
-    sprintf(sz, "%4.2f", GetLastDelta());
+    FormatLastDelta(sz, sizeof(sz));
     return std::string(sz);
   }
 
 private:
 
-  inline double TicksToSeconds(LONGLONG n) const
-  {
-    return (double)n / m_freq;
-  }
-
-  double m_freq;// units per second
-  LONGLONG m_lasttick;// 1 tick ago
-  LONGLONG m_lasttick2;// 2 ticks ago
-  LONGLONG m_delta;// diff between lasttick and lasttick2
+  long long m_lasttick;// 1 tick ago, in ns
+  long long m_lasttick2;// 2 ticks ago
+  long long m_delta;// diff between lasttick and lasttick2
 };
 
@@ -0,0 +1,309 @@
+/*
+  Scratch memory that only has to last until the end of the frame.  Allocating is bumping a
+  pointer, freeing is nothing, and the whole thing is thrown away at once when the next frame
+  starts, so the rasterizers' temporary tables and lists never touch the heap once it's warmed
+  up.
+
+    FrameArena::NextFrame();// once per frame, before drawing anything
+    ...
+    FrameArena& arena = FrameArena::Current();// this thread's
+    Height_T* p = arena.Alloc<Height_T>(n);
+    FrameVector<long> v(&arena);// a std::vector that lives in the arena
+
+  Every thread has its own arena (so no locking), and each one resets itself the first time it's
+  used after NextFrame().  Don't call NextFrame() while anything is still drawing, and don't keep
+  anything from an arena past the frame it came from.
+
+  It's opt-in: the rasterizers that can use one (DrawCirclesAA(), FilledCircleAARows(),
+  ScanlineRenderer::Draw()...) take a FrameArena* that defaults to 0, which means plain heap
+  memory freed before they return.  Only pass an arena if something calls NextFrame().
+
+  A Scope gives back everything allocated while it was around, so scratch from one call gets
+  reused by the next one in the same frame instead of piling up:
+
+    FrameArena::Scope scope(pArena);// pArena can be 0
+
+  It starts with one ChunkSize block.  A frame that needs more gets extra blocks from the heap,
+  and the next reset trades the chunk in for one big enough for the most the frame had out at
+  once, so after the first frame or two it's one block and no heap traffic.
+
+  Blob can live in the arena with frame_blob_traits, and any STL container with ArenaAllocator.
+*/
+
+
+#pragma once
+
+
+#include <atomic>
+#include <new>
+#include <vector>
+#include "platform.h"
+#include "blob.h"
+
+
+class FrameArena
+{
+public:
+  static const size_t ChunkSize = 64 * 1024;
+  static const size_t DefaultAlignment = 16;
+
+  FrameArena() :
+    m_pChunk(0),
+    m_size(0),
+    m_used(0),
+    m_spilled(0),
+    m_frameHigh(0),
+    m_peak(0),
+    m_epoch(0)
+  {
+  }
+
+  ~FrameArena()
+  {
+    FreeOverflow();
+    if(m_pChunk)
+    {
+      AlignedFree(m_pChunk);
+    }
+  }
+
+  // this thread's arena.  the first call after NextFrame() resets it.
+  static FrameArena& Current()
+  {
+    static thread_local FrameArena arena;
+    unsigned long epoch = GetEpoch().load(std::memory_order_acquire);
+    if(arena.m_epoch != epoch)
+    {
+      arena.Reset();
+      arena.m_epoch = epoch;
+    }
+    return arena;
+  }
+
+  // everything handed out by every thread's arena is gone after this.
+  static void NextFrame()
+  {
+    GetEpoch().fetch_add(1, std::memory_order_release);
+  }
+
+  // alignment has to be a power of 2.  returns 0 if the heap is out.
+  void* Alloc(size_t bytes, size_t alignment = DefaultAlignment)
+  {
+    void* r = 0;
+    if(!m_pChunk)
+    {
+      m_pChunk = static_cast<BYTE*>(AlignedAlloc(ChunkSize, 64));
+      m_size = m_pChunk ? ChunkSize : 0;
+    }
+
+    size_t start = (m_used + alignment - 1) & ~(alignment - 1);
+    if(start + bytes <= m_size)
+    {
+      r = m_pChunk + start;
+      m_used = start + bytes;
+    }
+    else
+    {
+      // doesn't fit; this frame gets its own block, and the next one a bigger chunk
+      r = AlignedAlloc(bytes ? bytes : 1, alignment < 64 ? 64 : alignment);
+      if(r)
+      {
+        m_overflow.push_back(r);
+        m_spilled += bytes + alignment;
+      }
+    }
+
+    if(m_used + m_spilled > m_frameHigh)
+    {
+      m_frameHigh = m_used + m_spilled;
+    }
+    if(m_frameHigh > m_peak)
+    {
+      m_peak = m_frameHigh;
+    }
+    return r;
+  }
+
+  template<typename T>
+  T* Alloc(size_t n)
+  {
+    return static_cast<T*>(Alloc(sizeof(T) * n, alignof(T) > DefaultAlignment ? alignof(T) : DefaultAlignment));
+  }
+
+  // throws out everything.  Current() does this for you.
+  void Reset()
+  {
+    FreeOverflow();
+    if(m_frameHigh > m_size)
+    {
+      size_t size = ((m_frameHigh + ChunkSize - 1) / ChunkSize) * ChunkSize;
+      if(m_pChunk)
+      {
+        AlignedFree(m_pChunk);
+      }
+      m_pChunk = static_cast<BYTE*>(AlignedAlloc(size, 64));
+      m_size = m_pChunk ? size : 0;
+    }
+    m_spilled = 0;
+    m_used = 0;
+    m_frameHigh = 0;
+  }
+
+  // remembers where the arena is, and rewinds it there when it goes away.  scopes have to nest.
+  // an arena of 0 is fine; then it does nothing.
+  class Scope
+  {
+  public:
+    explicit Scope(FrameArena* pArena) :
+      m_pArena(pArena),
+      m_used(pArena ? pArena->m_used : 0),
+      m_spilled(pArena ? pArena->m_spilled : 0),
+      m_nOverflow(pArena ? pArena->m_overflow.size() : 0)
+    {
+    }
+
+    ~Scope()
+    {
+      if(m_pArena)
+      {
+        m_pArena->Rewind(m_used, m_spilled, m_nOverflow);
+      }
+    }
+
+  private:
+    Scope(const Scope&);
+    Scope& operator=(const Scope&);
+
+    FrameArena* m_pArena;
+    size_t m_used;
+    size_t m_spilled;
+    size_t m_nOverflow;
+  };
+
+  // bytes in use this frame, the most ever in one frame, and the size of the main block.
+  size_t GetUsed() const { return m_used + m_spilled; }
+  size_t GetPeak() const { return m_peak; }
+  size_t GetCapacity() const { return m_size; }
+
+private:
+  static std::atomic<unsigned long>& GetEpoch()
+  {
+    static std::atomic<unsigned long> epoch(1);
+    return epoch;
+  }
+
+  // back to what Scope saw.  the blocks that spilled since then are freed now; the chunk still
+  // grows at the next Reset(), since m_frameHigh remembers them.
+  void Rewind(size_t used, size_t spilled, size_t nOverflow)
+  {
+    for(size_t i = nOverflow; i < m_overflow.size(); i ++)
+    {
+      AlignedFree(m_overflow[i]);
+    }
+    m_overflow.resize(nOverflow);
+    m_spilled = spilled;
+    m_used = used;
+  }
+
+  void FreeOverflow()
+  {
+    for(size_t i = 0; i < m_overflow.size(); i ++)
+    {
+      AlignedFree(m_overflow[i]);
+    }
+    m_overflow.clear();
+  }
+
+  FrameArena(const FrameArena&);
+  FrameArena& operator=(const FrameArena&);
+
+  BYTE* m_pChunk;
+  size_t m_size;
+  size_t m_used;// of m_pChunk
+  size_t m_spilled;// in m_overflow
+  size_t m_frameHigh;// the most m_used + m_spilled has been since the last reset
+  size_t m_peak;
+  unsigned long m_epoch;// the frame we were last reset for
+  std::vector<void*> m_overflow;// blocks for what didn't fit in the chunk this frame
+};
+
+
+// an STL allocator that gets memory from an arena, or from the heap if the arena is 0.  freeing
+// arena memory does nothing.
+template<typename T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+
+  ArenaAllocator(FrameArena* pArena = 0) :
+    m_pArena(pArena)
+  {
+  }
+
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U>& rhs) :
+    m_pArena(rhs.GetArena())
+  {
+  }
+
+  T* allocate(size_t n)
+  {
+    T* r = m_pArena ? m_pArena->Alloc<T>(n) : static_cast<T*>(::operator new(sizeof(T) * n));
+    if(!r)
+    {
+      throw std::bad_alloc();
+    }
+    return r;
+  }
+
+  void deallocate(T* p, size_t)
+  {
+    if(!m_pArena)
+    {
+      ::operator delete(p);
+    }
+  }
+
+  FrameArena* GetArena() const
+  {
+    return m_pArena;
+  }
+
+private:
+  FrameArena* m_pArena;
+};
+
+template<typename T, typename U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+  return a.GetArena() == b.GetArena();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+  return a.GetArena() != b.GetArena();
+}
+
+
+// a vector that can live in an arena: FrameVector<long> v(&FrameArena::Current());
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T> >;
+
+
+// Blob traits for scratch Blobs: the memory comes from this thread's arena (so it's gone at the
+// next frame) and freeing it is free.
+class frame_blob_traits : public default_blob_traits
+{
+public:
+  static void* Alloc(size_t bytes, size_t alignment)
+  {
+    return FrameArena::Current().Alloc(bytes, alignment);
+  }
+
+  static void Free(void*)
+  {
+  }
+};
+
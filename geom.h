@@ -2,14 +2,25 @@
   todo:
   -------------------------------------------
         -) support odd diameters
-        -) write line functions
-        -) write thickline functions
 */
 
 
 #pragma once
 
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "blob.h"
+#include "circletables.h"
+#include "framearena.h"
+#include "spanbuffer.h"
+#include "threadpool.h"
+#include "profile.h"
+
+
 // stores heights of a circle, and can repeat them out for any X.
 class CircleHeights
 {
@@ -19,7 +30,19 @@ public:
   template<typename T>
   void Init(T radius)
   {
+    GEOM_ZONE("CircleHeights::Init");
     m_rad = static_cast<Height_T>(radius);
+
+#if GEOM_STATIC_CIRCLE_TABLES > 0
+    typedef StaticCircleTables<SCT_Plain> Static_T;
+    if(radius >= 0 && radius <= Static_T::MaxRadius)
+    {
+      m_pHeights = Static_T::data.heights + Static_T::Data_T::Offset(radius);
+      m_45 = Static_T::data.mark45[radius];
+      return;
+    }
+#endif
+
     //radius -= 1;
     long d = 3 - (2 * radius);
     long x = 0;
@@ -27,6 +50,7 @@ public:
     m_buf.Realloc(radius+1);
     Height_T* pStart = m_buf.GetLockedBuffer();
     Height_T* pEnd = pStart + radius - 1;
+    m_pHeights = pStart;
     *pStart = static_cast<Height_T>(radius);
 
     while(x <= y)
@@ -54,12 +78,13 @@ public:
   }
 
   // no bound checking for optimization
-  template<typename T> inline Height_T GetHeight(T x) const { return m_buf.GetLockedBuffer()[static_cast<Height_T>(x)]; }
+  template<typename T> inline Height_T GetHeight(T x) const { return m_pHeights[static_cast<Height_T>(x)]; }
   inline Height_T Get45Mark() const { return m_45; }
   inline Height_T GetRadius() const { return m_rad; }
 private:
   Height_T m_45;// at what X does the 45 degree point hit?
   Height_T m_rad;
+  const Height_T* m_pHeights;// either m_buf or the compile-time tables
   Blob<Height_T, false, true, default_blob_traits, 1000> m_buf;
 };
 
@@ -77,6 +102,7 @@ public:
   template<typename T>
   void Init(T radius)
   {
+    GEOM_ZONE("CircleHeightsAA::Init");
     long hMinus1;
     long hMinus1Squared;
     long hPlus1;
@@ -85,6 +111,20 @@ public:
     Height_T* pAA;
 
     m_rad = static_cast<Height_T>(radius);
+
+#if GEOM_STATIC_CIRCLE_TABLES > 0
+    typedef StaticCircleTables<bInner ? SCT_AAInner : SCT_AAOuter> Static_T;
+    if(radius >= 0 && radius <= Static_T::MaxRadius)
+    {
+      long offset = Static_T::Data_T::Offset(radius);
+      m_pHeights = Static_T::data.heights + offset;
+      m_pAAValues = Static_T::data.aavalues + offset;
+      m_45 = Static_T::data.mark45[radius];
+      m_aamax = Static_T::data.aamax[radius];
+      return;
+    }
+#endif
+
     long x = 0;
     long x2 = 0;// x squared
     long r2 = radius * radius;
@@ -96,6 +136,8 @@ public:
 
     Height_T* pStart = m_heights.GetLockedBuffer();
     Height_T* pEnd = pStart + radius;
+    m_pHeights = pStart;
+    m_pAAValues = pAA;
 
     hPlus1 = h + 1;
     hPlus1Squared = hPlus1 * hPlus1;
@@ -160,8 +202,8 @@ public:
   }
 
   // no bound checking for optimization
-  template<typename T> inline Height_T GetHeight(T x) const { return m_heights.GetLockedBuffer()[static_cast<Height_T>(x)]; }
-  template<typename T> inline Height_T GetAAValue(T x) const { return m_aavalues.GetLockedBuffer()[static_cast<Height_T>(x)]; }
+  template<typename T> inline Height_T GetHeight(T x) const { return m_pHeights[static_cast<Height_T>(x)]; }
+  template<typename T> inline Height_T GetAAValue(T x) const { return m_pAAValues[static_cast<Height_T>(x)]; }
   inline Height_T Get45Mark() const { return m_45; }
   inline Height_T GetRadius() const { return m_rad; }
   inline Height_T GetAAMax() const { return m_aamax; }
@@ -169,18 +211,399 @@ private:
   Height_T m_45;// at what X does the 45 degree point hit?
   Height_T m_rad;
   Height_T m_aamax;// maximum number for antialias values.
+  const Height_T* m_pHeights;// these point to either the blobs below or the compile-time tables
+  const Height_T* m_pAAValues;
   Blob<Height_T, false, true, default_blob_traits, 1000> m_heights;
   Blob<Height_T, false, true, default_blob_traits, 1000> m_aavalues;
 };
 
 
+/*
+  Axis-aligned ellipses.  rx is how far the ellipse goes left and right of the center, ry up and
+  down.  Same center as the circles (the corner between 4 pixels), so the ellipse covers the
+  pixels cx-rx .. cx+rx-1 and cy-ry .. cy+ry-1, and rx == ry is a circle.
+
+  A pixel is in if its center is: ry^2 (2x+1)^2 + rx^2 (2y+1)^2 <= 4 rx^2 ry^2.  rx and ry have to
+  be under 32768 so that fits in 64 bits.
+*/
+
+// walks the right edge of an ellipse down from the middle row, one row at a time.  the width only
+// ever shrinks as y goes up, so it's all adds.  swap rx and ry to walk the bottom edge across
+// instead.
+//
+// everything is in half pixels so pixel centers are whole numbers: X = 2x+1, Y = 2y+1.  with
+// bCorners it tests the outer corner of each pixel (X = 2x+2, Y = 2y+2) instead, so only pixels
+// that are entirely inside count, and the next one over is the one the edge goes through.  that's
+// what the AA tables want.
+class EllipseEdge
+{
+public:
+  EllipseEdge(long rx, long ry, bool bCorners) :
+    m_rx2(static_cast<LONGLONG>(rx) * rx),
+    m_ry2(static_cast<LONGLONG>(ry) * ry),
+    m_w(rx),
+    m_X(2 * rx - (bCorners ? 0 : 1)),
+    m_Y(bCorners ? 2 : 1)
+  {
+    m_fx = m_ry2 * m_X * m_X;
+    m_fy = (m_rx2 * m_Y * m_Y) - (4 * m_rx2 * m_ry2);
+    Fit();
+  }
+
+  void NextRow()
+  {
+    m_fy += m_rx2 * (4 * m_Y + 4);
+    m_Y += 2;
+    Fit();
+  }
+
+  // # of pixels in this row, each side of the center.  can be 0 on very flat ellipses.
+  inline long GetWidth() const { return m_w; }
+
+  // true while the edge is closer to vertical than horizontal, which is where one AA pixel per
+  // row looks right.
+  inline bool IsSteep() const
+  {
+    return (m_ry2 * (m_X + 1)) >= (m_rx2 * m_Y);
+  }
+
+  // how much of the next pixel out (x = GetWidth()) is inside, 0-255.  it's where the edge
+  // crosses between the last point tested inside and the same point on that pixel.  only makes
+  // sense with bCorners.
+  BYTE GetCoverage() const
+  {
+    LONGLONG num = -(m_fx + m_fy);
+    LONGLONG den = m_ry2 * (4 * m_X + 4);
+    BYTE r = 0;
+    if(num > 0 && den > 0)
+    {
+      while(den > (1LL << 54))
+      {
+        num >>= 1;
+        den >>= 1;
+      }
+      LONGLONG c = (num * 255) / den;
+      r = static_cast<BYTE>(c > 255 ? 255 : c);
+    }
+    return r;
+  }
+
+private:
+  // pull the width in until the last pixel is inside.
+  inline void Fit()
+  {
+    while(m_w > 0 && (m_fx + m_fy) > 0)
+    {
+      m_fx -= m_ry2 * (4 * m_X - 4);
+      m_X -= 2;
+      m_w --;
+    }
+  }
+
+  LONGLONG m_rx2;
+  LONGLONG m_ry2;
+  LONGLONG m_fx;// ry^2 X^2 for the last pixel in the row
+  LONGLONG m_fy;// rx^2 Y^2 - 4 rx^2 ry^2 for this row
+  long m_w;
+  long m_X;
+  long m_Y;
+};
+
+
+// stores the widths of an ellipse.  row y is cx - w .. cx + w - 1 where w = GetWidth(y), mirrored
+// to rows cy + y and cy - y - 1 just like the circles.
+class EllipseHeights
+{
+public:
+  typedef unsigned short Height_T;
+
+  void Init(long rx, long ry)
+  {
+    if(rx < 0) rx = 0;
+    if(ry < 0) ry = 0;
+    m_rx = static_cast<Height_T>(rx);
+    m_ry = static_cast<Height_T>(ry);
+
+    m_widths.Realloc(ry + 1);
+    Height_T* p = m_widths.GetLockedBuffer();
+    EllipseEdge edge(rx, ry, false);
+    for(long y = 0; y < ry; y ++)
+    {
+      p[y] = static_cast<Height_T>(edge.GetWidth());
+      edge.NextRow();
+    }
+    m_pWidths = p;
+  }
+
+  // no bound checking for optimization
+  template<typename T> inline Height_T GetWidth(T y) const { return m_pWidths[static_cast<Height_T>(y)]; }
+  inline Height_T GetRadiusX() const { return m_rx; }
+  inline Height_T GetRadiusY() const { return m_ry; }
+private:
+  Height_T m_rx;
+  Height_T m_ry;
+  const Height_T* m_pWidths;
+  Blob<Height_T, false, true, default_blob_traits, 1000> m_widths;
+};
+
+
+// widths plus AA pixels for an ellipse.  like CircleHeightsAA the widths only count pixels that
+// are entirely inside; the edge goes through the AA pixels.  circles get away with one octant of AA values flipped
+// around; ellipses need two runs.  where the edge is steep there's one AA pixel per row, at
+// (GetWidth(y), y) for y < GetRowAACount().  where it's flat there's one per column, at
+// (x, GetColumnAAHeight(x)) for x < GetColumnAACount().  the column run only takes the rows the
+// row run didn't, so no pixel gets both.  AA values go from 0 to GetAAMax() like the circles.
+class EllipseHeightsAA
+{
+public:
+  typedef unsigned short Height_T;
+
+  void Init(long rx, long ry)
+  {
+    if(rx < 0) rx = 0;
+    if(ry < 0) ry = 0;
+    m_rx = static_cast<Height_T>(rx);
+    m_ry = static_cast<Height_T>(ry);
+    m_rowaa = 0;
+    m_colaa = 0;
+
+    m_widths.Realloc(ry + 1);
+    m_rowvalues.Realloc(ry + 1);
+    m_colheights.Realloc(rx + 1);
+    m_colvalues.Realloc(rx + 1);
+    Height_T* pWidths = m_widths.GetLockedBuffer();
+    Height_T* pRowValues = m_rowvalues.GetLockedBuffer();
+    Height_T* pColHeights = m_colheights.GetLockedBuffer();
+    Height_T* pColValues = m_colvalues.GetLockedBuffer();
+
+    bool bSteep = true;
+    EllipseEdge edge(rx, ry, true);
+    for(long y = 0; y < ry; y ++)
+    {
+      pWidths[y] = static_cast<Height_T>(edge.GetWidth());
+      bSteep = bSteep && edge.IsSteep();
+      if(bSteep)
+      {
+        pRowValues[y] = edge.GetCoverage();
+        m_rowaa ++;
+      }
+      edge.NextRow();
+    }
+
+    EllipseEdge bottom(ry, rx, true);
+    for(long x = 0; x < rx; x ++)
+    {
+      if(bottom.GetWidth() < m_rowaa)
+      {
+        break;
+      }
+      pColHeights[x] = static_cast<Height_T>(bottom.GetWidth());
+      pColValues[x] = bottom.GetCoverage();
+      m_colaa ++;
+      bottom.NextRow();
+    }
+
+    m_pWidths = pWidths;
+    m_pRowValues = pRowValues;
+    m_pColHeights = pColHeights;
+    m_pColValues = pColValues;
+  }
+
+  // no bound checking for optimization
+  template<typename T> inline Height_T GetWidth(T y) const { return m_pWidths[static_cast<Height_T>(y)]; }
+  template<typename T> inline Height_T GetRowAAValue(T y) const { return m_pRowValues[static_cast<Height_T>(y)]; }
+  template<typename T> inline Height_T GetColumnAAHeight(T x) const { return m_pColHeights[static_cast<Height_T>(x)]; }
+  template<typename T> inline Height_T GetColumnAAValue(T x) const { return m_pColValues[static_cast<Height_T>(x)]; }
+  inline Height_T GetRowAACount() const { return m_rowaa; }
+  inline Height_T GetColumnAACount() const { return m_colaa; }
+  inline Height_T GetRadiusX() const { return m_rx; }
+  inline Height_T GetRadiusY() const { return m_ry; }
+  inline Height_T GetAAMax() const { return 255; }
+private:
+  Height_T m_rx;
+  Height_T m_ry;
+  Height_T m_rowaa;
+  Height_T m_colaa;
+  const Height_T* m_pWidths;
+  const Height_T* m_pRowValues;
+  const Height_T* m_pColHeights;
+  const Height_T* m_pColValues;
+  Blob<Height_T, false, true, default_blob_traits, 1000> m_widths;
+  Blob<Height_T, false, true, default_blob_traits, 1000> m_rowvalues;
+  Blob<Height_T, false, true, default_blob_traits, 1000> m_colheights;
+  Blob<Height_T, false, true, default_blob_traits, 1000> m_colvalues;
+};
+
+
+/*
+  Shared, immutable circle tables.  Scenes tend to draw lots of circles with only a handful of
+  different radii, so rather than Init() a new table on the stack for every call, the *G functions
+  get them from here.  There is one cache per table type (CircleHeights, CircleHeightsAA<false>,
+  CircleHeightsAA<true>), each holding up to GetCapacity() radii; the least recently used one is
+  thrown out when it's full.
+
+  Tables are handed out as shared_ptrs to const, so an evicted table stays alive until the last
+  caller is done with it, and any number of threads can read the same table.
+*/
+template<typename Ttable>
+class CircleTableCache
+{
+public:
+  typedef std::shared_ptr<const Ttable> TablePtr;
+
+  static const long DefaultCapacity = 64;
+
+  CircleTableCache() :
+    m_capacity(DefaultCapacity),
+    m_clock(0),
+    m_hits(0),
+    m_misses(0)
+  {
+  }
+
+  static CircleTableCache& Instance()
+  {
+    static CircleTableCache instance;
+    return instance;
+  }
+
+  TablePtr Get(long radius)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      Entry* e = Find(radius);
+      if(e)
+      {
+        e->lastuse = ++ m_clock;
+        m_hits ++;
+        GEOM_COUNT(PC_TableHits, 1);
+        return e->table;
+      }
+      m_misses ++;
+      GEOM_COUNT(PC_TableMisses, 1);
+    }
+
+    // build it without holding the lock; Init() can take a while for big radii.
+    std::shared_ptr<Ttable> pNew = std::make_shared<Ttable>();
+    pNew->Init(radius);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry* e = Find(radius);
+    if(!e)
+    {
+      // somebody else didnt beat us to it, so store ours.
+      e = Victim();
+      e->radius = radius;
+      e->table = pNew;
+    }
+    e->lastuse = ++ m_clock;
+    return e->table;
+  }
+
+  // shrinking the capacity drops everything.
+  void SetCapacity(long n)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(n < 1) n = 1;
+    if(n < m_capacity)
+    {
+      m_entries.clear();
+    }
+    m_capacity = n;
+  }
+
+  long GetCapacity() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capacity;
+  }
+
+  void Clear()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+  }
+
+  long GetHits() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+  }
+
+  long GetMisses() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+  }
+
+private:
+  struct Entry
+  {
+    long radius;
+    unsigned long lastuse;
+    TablePtr table;
+  };
+
+  // m_mutex must be held
+  Entry* Find(long radius)
+  {
+    Entry* r = 0;
+    for(size_t i = 0; i < m_entries.size(); i ++)
+    {
+      if(m_entries[i].radius == radius)
+      {
+        r = &m_entries[i];
+        break;
+      }
+    }
+    return r;
+  }
+
+  // m_mutex must be held.  returns an empty slot or the least recently used one.
+  Entry* Victim()
+  {
+    if(static_cast<long>(m_entries.size()) < m_capacity)
+    {
+      m_entries.push_back(Entry());
+      return &m_entries.back();
+    }
+
+    Entry* r = &m_entries[0];
+    for(size_t i = 1; i < m_entries.size(); i ++)
+    {
+      if(m_entries[i].lastuse < r->lastuse)
+      {
+        r = &m_entries[i];
+      }
+    }
+    return r;
+  }
+
+  mutable std::mutex m_mutex;// guards everything below
+  std::vector<Entry> m_entries;
+  long m_capacity;
+  unsigned long m_clock;
+  long m_hits;
+  long m_misses;
+};
+
+
+// shorthand for CircleTableCache<Ttable>::Instance().Get(radius)
+template<typename Ttable>
+inline std::shared_ptr<const Ttable> GetCircleTable(long radius)
+{
+  return CircleTableCache<Ttable>::Instance().Get(radius);
+}
+
+
+
 
 
 template<typename Tsh, typename Tshproc, typename Ta, typename Taproc>
 void FilledCircleAAG(long cx, long cy, long r, Tsh sh, Tshproc shproc, Ta a, Taproc aproc)
 {
-  CircleHeightsAA<false> heights;
-  heights.Init(r);
+  std::shared_ptr<const CircleHeightsAA<false> > pHeights = GetCircleTable<CircleHeightsAA<false> >(r);
+  const CircleHeightsAA<false>& heights = *pHeights;
   CircleHeightsAA<false>::Height_T h;
 
   for(long y = 0; y < r; ++ y)
@@ -204,8 +627,8 @@ void FilledCircleAAG(long cx, long cy, long r, Tsh sh, Tshproc shproc, Ta a, Tap
 template<typename Tsh, typename Tshproc>
 void FilledCircleG(long cx, long cy, long r, Tsh sh, Tshproc shproc)
 {
-  CircleHeights heights;
-  heights.Init(r);
+  std::shared_ptr<const CircleHeights> pHeights = GetCircleTable<CircleHeights>(r);
+  const CircleHeights& heights = *pHeights;
   CircleHeights::Height_T h;
 
   for(long y = 0; y < r; ++ y)
@@ -222,11 +645,10 @@ void FilledCircleG(long cx, long cy, long r, Tsh sh, Tshproc shproc)
 template<typename Th, typename Thproc>
 void DonutG(long cx, long cy, long rin, long width, Th h, Thproc hproc)
 {
-  CircleHeights outer;
-  CircleHeights inner;
-
-  outer.Init(rin+width);
-  inner.Init(rin);
+  std::shared_ptr<const CircleHeights> pOuter = GetCircleTable<CircleHeights>(rin+width);
+  std::shared_ptr<const CircleHeights> pInner = GetCircleTable<CircleHeights>(rin);
+  const CircleHeights& outer = *pOuter;
+  const CircleHeights& inner = *pInner;
 
   long y;
   CircleHeights::Height_T hOuter;
@@ -257,11 +679,10 @@ void DonutG(long cx, long cy, long rin, long width, Th h, Thproc hproc)
 template<typename Th, typename Thproc, typename Ta, typename Taproc>
 void DonutAAG(long cx, long cy, long rin, long width, Th h, Thproc hproc, Ta a, Taproc aproc)
 {
-  CircleHeightsAA<false> outer;
-  CircleHeightsAA<true> inner;
-
-  outer.Init(rin+width);
-  inner.Init(rin);
+  std::shared_ptr<const CircleHeightsAA<false> > pOuter = GetCircleTable<CircleHeightsAA<false> >(rin+width);
+  std::shared_ptr<const CircleHeightsAA<true> > pInner = GetCircleTable<CircleHeightsAA<true> >(rin);
+  const CircleHeightsAA<false>& outer = *pOuter;
+  const CircleHeightsAA<true>& inner = *pInner;
 
   long y;
   CircleHeightsAA<true>::Height_T hOuter;
@@ -307,3 +728,2276 @@ void DonutAAG(long cx, long cy, long rin, long width, Th h, Thproc hproc, Ta a,
   return;
 }
 
+
+// ellipses.  same callbacks as the circles.  the tables are cheap to build (rx + ry steps) and
+// there are a lot more (rx, ry) pairs than radii, so they aren't cached.
+template<typename Tsh, typename Tshproc>
+void FilledEllipseG(long cx, long cy, long rx, long ry, Tsh sh, Tshproc shproc)
+{
+  EllipseHeights heights;
+  heights.Init(rx, ry);
+  EllipseHeights::Height_T w;
+
+  for(long y = 0; y < heights.GetRadiusY(); ++ y)
+  {
+    w = heights.GetWidth(y);
+    if(w)
+    {
+      (sh->*shproc)(cx - w, cx + w - 1, cy + y);
+      (sh->*shproc)(cx - w, cx + w - 1, cy - y - 1);
+    }
+  }
+
+  return;
+}
+
+
+template<typename Tsh, typename Tshproc, typename Ta, typename Taproc>
+void FilledEllipseAAG(long cx, long cy, long rx, long ry, Tsh sh, Tshproc shproc, Ta a, Taproc aproc)
+{
+  EllipseHeightsAA heights;
+  heights.Init(rx, ry);
+  EllipseHeightsAA::Height_T w;
+
+  for(long y = 0; y < heights.GetRadiusY(); ++ y)
+  {
+    w = heights.GetWidth(y);
+    if(w)
+    {
+      (sh->*shproc)(cx - w, cx + w - 1, cy + y);
+      (sh->*shproc)(cx - w, cx + w - 1, cy - y - 1);
+    }
+  }
+
+  for(long y = 0; y < heights.GetRowAACount(); ++ y)
+  {
+    (a->*aproc)(cx, cy, heights.GetWidth(y), y, heights.GetRowAAValue(y), heights.GetAAMax());
+  }
+
+  for(long x = 0; x < heights.GetColumnAACount(); ++ x)
+  {
+    (a->*aproc)(cx, cy, x, heights.GetColumnAAHeight(x), heights.GetColumnAAValue(x), heights.GetAAMax());
+  }
+
+  return;
+}
+
+
+// an elliptical donut.  the hole is rxin by ryin, and the ring is "width" thick all the way around.
+template<typename Th, typename Thproc>
+void EllipseRingG(long cx, long cy, long rxin, long ryin, long width, Th h, Thproc hproc)
+{
+  EllipseHeights outer;
+  EllipseHeights inner;
+  outer.Init(rxin + width, ryin + width);
+  inner.Init(rxin, ryin);
+
+  long y;
+  EllipseHeights::Height_T wOuter;
+  EllipseHeights::Height_T wInner;
+
+  for(y = 0; y < inner.GetRadiusY(); y ++)
+  {
+    wOuter = outer.GetWidth(y);
+    wInner = inner.GetWidth(y);
+    if(wOuter > wInner)
+    {
+      (h->*hproc)(cx + wInner, cx + wOuter - 1, cy + y);
+      (h->*hproc)(cx + wInner, cx + wOuter - 1, cy - y - 1);
+      (h->*hproc)(cx - wOuter, cx - wInner - 1, cy + y);
+      (h->*hproc)(cx - wOuter, cx - wInner - 1, cy - y - 1);
+    }
+  }
+
+  for(; y < outer.GetRadiusY(); ++ y)
+  {
+    wOuter = outer.GetWidth(y);
+    if(wOuter)
+    {
+      (h->*hproc)(cx - wOuter, cx + wOuter - 1, cy + y);
+      (h->*hproc)(cx - wOuter, cx + wOuter - 1, cy - y - 1);
+    }
+  }
+
+  return;
+}
+
+
+/*
+  Span-batch versions of the above.  Same shapes, same spans, but instead of calling back through
+  member pointers they write into "sink", which is normally a SpanBuffer (see spanbuffer.h) but
+  can be anything with these two methods:
+
+    void AddSpan(long x1, long x2, long y);       // x1 through x2, both inclusive
+    void AddCoverage(long x, long y, BYTE c);     // one AA pixel, c is 0-255
+
+  AA pixels come out already mirrored into all four quadrants and with their coverage normalized
+  against the table's GetAAMax(), so the sink never has to know about either.
+
+  All of them can take a ClipRect (see spanbuffer.h).  Rows that are entirely outside it are
+  never looked at, an AA run (one octant's worth) that can't touch it is skipped as a whole, and
+  everything that does come out is already clipped, so the sink can write straight to memory.
+*/
+
+// 16.16 factor that turns 0..fmax into 0..255
+inline long CoverageScale(long fmax)
+{
+  return fmax > 0 ? ((255 << 16) + (fmax >> 1)) / fmax : 0;
+}
+
+inline BYTE ScaleCoverage(long f, long scale)
+{
+  long c = ((f * scale) + 0x8000) >> 16;
+  return static_cast<BYTE>(c > 255 ? 255 : c);
+}
+
+// the y's that can land inside the clip, as either row cy + y or row cy - y - 1.  the shapes are
+// all mirrored that way, so this is the only part of their tables worth walking.
+inline void GetClipRows(const ClipRect& clip, long cy, long& y0, long& y1)
+{
+  long lo0 = clip.top - cy;// cy + y
+  long lo1 = clip.bottom - cy;
+  long up0 = cy - clip.bottom;// cy - y - 1
+  long up1 = cy - clip.top;
+  if(lo0 < 0) lo0 = 0;
+  if(up0 < 0) up0 = 0;
+
+  y0 = 0;
+  y1 = 0;
+  if(lo0 < lo1)
+  {
+    y0 = lo0;
+    y1 = lo1;
+  }
+  if(up0 < up1)
+  {
+    if(y0 >= y1 || up0 < y0) y0 = up0;
+    if(up1 > y1) y1 = up1;
+  }
+}
+
+// can any of the 4 mirrors of a run of AA pixels, x0 <= x <= x1 and y0 <= y <= y1, be inside
+// the clip?  (same mirroring as AddCoverage4)
+inline bool IsRunVisible(const ClipRect& clip, long cx, long cy, long x0, long x1, long y0, long y1)
+{
+  bool bX = ((cx + x1 >= clip.left) && (cx + x0 < clip.right)) ||
+    ((cx - x0 - 1 >= clip.left) && (cx - x1 - 1 < clip.right));
+  bool bY = ((cy + y1 >= clip.top) && (cy + y0 < clip.bottom)) ||
+    ((cy - y0 - 1 >= clip.top) && (cy - y1 - 1 < clip.bottom));
+  return bX && bY;
+}
+
+template<typename Tsink>
+inline void AddClippedSpan(Tsink& sink, const ClipRect& clip, long x1, long x2, long y)
+{
+  if(y >= clip.top && y < clip.bottom)
+  {
+    if(x1 < clip.left) x1 = clip.left;
+    if(x2 >= clip.right) x2 = clip.right - 1;
+    if(x1 <= x2)
+    {
+      sink.AddSpan(x1, x2, y);
+    }
+  }
+}
+
+template<typename Tsink>
+inline void AddClippedCoverage(Tsink& sink, const ClipRect& clip, long x, long y, BYTE c)
+{
+  if(clip.Contains(x, y))
+  {
+    sink.AddCoverage(x, y, c);
+  }
+}
+
+// the 4 quadrant mirrors of an AA pixel, the same ones the *G aproc callbacks fill in.
+template<typename Tsink>
+inline void AddCoverage4(Tsink& sink, const ClipRect& clip, long cx, long cy, long x, long y, BYTE c)
+{
+  AddClippedCoverage(sink, clip, cx + x, cy + y, c);
+  AddClippedCoverage(sink, clip, cx + x, cy - y - 1, c);
+  AddClippedCoverage(sink, clip, cx - x - 1, cy + y, c);
+  AddClippedCoverage(sink, clip, cx - x - 1, cy - y - 1, c);
+}
+
+
+// these take the table(s) directly, so several threads can share one lookup (see the *Bands
+// functions further down).  the versions without tables just look them up and call these.
+template<typename Tsink>
+void FilledCircleSpans(const CircleHeights& heights, long cx, long cy, const ClipRect& clip, Tsink& sink)
+{
+  GEOM_ZONE("FilledCircleSpans");
+  long r = heights.GetRadius();
+  long y0, y1;
+  GetClipRows(clip, cy, y0, y1);
+  if(y1 > r) y1 = r;
+  CircleHeights::Height_T h;
+
+  for(long y = y0; y < y1; ++ y)
+  {
+    h = heights.GetHeight(y);
+    AddClippedSpan(sink, clip, cx - h - 1, cx + h, cy + y);
+    AddClippedSpan(sink, clip, cx - h - 1, cx + h, cy - y - 1);
+  }
+}
+
+
+// the AA pixels of one CircleHeightsAA table, both octant runs.  hOffset is 1 for the outside
+// of a circle and 0 for the hole in a donut.
+template<bool bInner, typename Tsink>
+void CircleAASpans(const CircleHeightsAA<bInner>& heights, long hOffset, long cx, long cy, const ClipRect& clip, Tsink& sink)
+{
+  GEOM_ZONE("CircleAASpans");
+  long m45 = heights.Get45Mark();
+  if(m45 < 1)
+  {
+    return;
+  }
+
+  long scale = CoverageScale(heights.GetAAMax());
+  long hMax = heights.GetHeight(0) + hOffset;
+  long hMin = heights.GetHeight(m45 - 1) + hOffset;
+  long y0, y1;
+  long h;
+  BYTE c;
+
+  // (h, y): one pixel per row, so only the rows in the clip
+  if(IsRunVisible(clip, cx, cy, hMin, hMax, 0, m45 - 1))
+  {
+    GetClipRows(clip, cy, y0, y1);
+    if(y1 > m45) y1 = m45;
+    for(long y = y0; y < y1; y ++)
+    {
+      h = heights.GetHeight(y) + hOffset;
+      c = ScaleCoverage(heights.GetAAValue(y), scale);
+      AddCoverage4(sink, clip, cx, cy, h, y, c);
+    }
+  }
+
+  // (y, h): one pixel per column
+  if(IsRunVisible(clip, cx, cy, 0, m45 - 1, hMin, hMax))
+  {
+    for(long y = 0; y < m45; y ++)
+    {
+      h = heights.GetHeight(y) + hOffset;
+      c = ScaleCoverage(heights.GetAAValue(y), scale);
+      AddCoverage4(sink, clip, cx, cy, y, h, c);
+    }
+  }
+}
+
+
+template<typename Tsink>
+void FilledCircleAASpans(const CircleHeightsAA<false>& heights, long cx, long cy, const ClipRect& clip, Tsink& sink)
+{
+  GEOM_ZONE("FilledCircleAASpans");
+  long r = heights.GetRadius();
+  long y0, y1;
+  GetClipRows(clip, cy, y0, y1);
+  if(y1 > r) y1 = r;
+  CircleHeightsAA<false>::Height_T h;
+
+  for(long y = y0; y < y1; ++ y)
+  {
+    h = heights.GetHeight(y);
+    AddClippedSpan(sink, clip, cx - h - 1, cx + h, cy + y);
+    AddClippedSpan(sink, clip, cx - h - 1, cx + h, cy - y - 1);
+  }
+
+  CircleAASpans(heights, 1, cx, cy, clip, sink);
+}
+
+
+template<typename Tsink>
+void DonutSpans(const CircleHeights& outer, const CircleHeights& inner, long cx, long cy, const ClipRect& clip, Tsink& sink)
+{
+  GEOM_ZONE("DonutSpans");
+  long rin = inner.GetRadius();
+  long rout = outer.GetRadius();
+  long y0, y1;
+  GetClipRows(clip, cy, y0, y1);
+  long yEnd = y1 < rin ? y1 : rin;
+  long y;
+  CircleHeights::Height_T hOuter;
+  CircleHeights::Height_T hInner;
+
+  for(y = y0; y < yEnd; y ++)
+  {
+    hOuter = outer.GetHeight(y);
+    hInner = inner.GetHeight(y);
+    AddClippedSpan(sink, clip, cx + hInner + 1, cx + hOuter, cy + y);
+    AddClippedSpan(sink, clip, cx + hInner + 1, cx + hOuter, cy - y - 1);
+    AddClippedSpan(sink, clip, cx - 1 - hOuter, cx - hInner - 2, cy + y);
+    AddClippedSpan(sink, clip, cx - 1 - hOuter, cx - hInner - 2, cy - y - 1);
+  }
+
+  yEnd = y1 < rout ? y1 : rout;
+  for(y = y0 > rin ? y0 : rin; y < yEnd; ++ y)
+  {
+    hOuter = outer.GetHeight(y);
+    AddClippedSpan(sink, clip, cx - 1 - hOuter, cx + hOuter, cy + y);
+    AddClippedSpan(sink, clip, cx - 1 - hOuter, cx + hOuter, cy - y - 1);
+  }
+}
+
+
+template<typename Tsink>
+void DonutAASpans(const CircleHeightsAA<false>& outer, const CircleHeightsAA<true>& inner, long cx, long cy, const ClipRect& clip, Tsink& sink)
+{
+  GEOM_ZONE("DonutAASpans");
+  long rin = inner.GetRadius();
+  long rout = outer.GetRadius();
+  long y0, y1;
+  GetClipRows(clip, cy, y0, y1);
+  long yEnd = y1 < rin ? y1 : rin;
+  long y;
+  CircleHeightsAA<true>::Height_T hOuter;
+  CircleHeightsAA<true>::Height_T hInner;
+
+  for(y = y0; y < yEnd; y ++)
+  {
+    hOuter = outer.GetHeight(y);
+    hInner = inner.GetHeight(y);
+    AddClippedSpan(sink, clip, cx + hInner + 1, cx + hOuter, cy + y);
+    AddClippedSpan(sink, clip, cx + hInner + 1, cx + hOuter, cy - y - 1);
+    AddClippedSpan(sink, clip, cx - hOuter - 1, cx - hInner - 2, cy + y);
+    AddClippedSpan(sink, clip, cx - hOuter - 1, cx - hInner - 2, cy - y - 1);
+  }
+
+  yEnd = y1 < rout ? y1 : rout;
+  for(y = y0 > rin ? y0 : rin; y < yEnd; ++ y)
+  {
+    hOuter = outer.GetHeight(y);
+    AddClippedSpan(sink, clip, cx - hOuter - 1, cx + hOuter, cy + y);
+    AddClippedSpan(sink, clip, cx - hOuter - 1, cx + hOuter, cy - y - 1);
+  }
+
+  CircleAASpans(inner, 0, cx, cy, clip, sink);
+  CircleAASpans(outer, 1, cx, cy, clip, sink);
+}
+
+
+/*
+  Single pass versions of FilledCircleAASpans() / DonutAASpans().  Those do the spans first and
+  then walk each octant's AA run on its own, so right around 45 degrees both runs can put a pixel
+  in the same place, and some AA pixels land on top of a span; either way the pixel gets blended
+  twice.  These go one scanline at a time instead, top to bottom, and each row comes out left to
+  right as AA pixels, solid span(s), AA pixels, with every pixel in it exactly once:
+
+    - where both octant runs hit the same pixel, the bigger coverage wins.
+    - AA pixels that land on a span are dropped; the span already has them solid.
+    - in a donut thin enough that the outside edge and the hole's edge share pixels, those get
+      (outer + inner - 255), the part that is inside both.
+
+  So the output is a little different from the 2 pass versions (by exactly the pixels that were
+  blended twice), but it can go to a sink that writes instead of blends, like a coverage mask.
+*/
+
+// # of x's in 0..m45-1 whose column AA pixel (x, h) is on row "row" or further out.  heights
+// only go down as x goes up, so it's a binary search.
+template<bool bInner>
+inline long CountAAColumns(const CircleHeightsAA<bInner>& heights, long m45, long hOffset, long row)
+{
+  long lo = 0;
+  long hi = m45;
+  long mid;
+  while(lo < hi)
+  {
+    mid = (lo + hi) >> 1;
+    if(heights.GetHeight(mid) + hOffset >= row)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// coverage of the quadrant pixel (x, row) from either octant run, 0 if neither has it.
+template<bool bInner>
+inline long GetQuadrantAA(const CircleHeightsAA<bInner>& heights, long m45, long hOffset, long scale, long x, long row)
+{
+  long c = 0;
+  long c2;
+  if(row < m45 && x == heights.GetHeight(row) + hOffset)
+  {
+    c = ScaleCoverage(heights.GetAAValue(row), scale);
+  }
+  if(x < m45 && row == heights.GetHeight(x) + hOffset)
+  {
+    c2 = ScaleCoverage(heights.GetAAValue(x), scale);
+    if(c2 > c) c = c2;
+  }
+  return c;
+}
+
+// one row of the quadrant (x >= 0, row >= 0) at a time, the way *AARows() need it.  x's from
+// GetFirst() to GetLast() have something in them; GetCoreFirst() to GetCoreLast() of those are
+// solid (none if first > last), and the rest need GetCoverage().  pInner is 0 for no hole.
+class CircleAARow
+{
+public:
+  CircleAARow(const CircleHeightsAA<false>& outer, const CircleHeightsAA<true>* pInner) :
+    m_outer(outer),
+    m_pInner(pInner),
+    m_rout(outer.GetRadius()),
+    m_rin(pInner ? pInner->GetRadius() : 0),
+    m_m45out(outer.Get45Mark()),
+    m_m45in(pInner ? pInner->Get45Mark() : 0),
+    m_scaleOut(CoverageScale(outer.GetAAMax())),
+    m_scaleIn(pInner ? CoverageScale(pInner->GetAAMax()) : 0),
+    m_row(0),
+    m_hOut(-1),
+    m_hIn(-1),
+    m_first(0),
+    m_last(-1)
+  {
+  }
+
+  // rows past this are empty.
+  long GetRowCount() const
+  {
+    long n = m_rout;
+    if(m_m45out > 0 && m_outer.GetHeight(0) + 2 > n)
+    {
+      n = m_outer.GetHeight(0) + 2;
+    }
+    return n;
+  }
+
+  void SetRow(long row)
+  {
+    long n;
+    m_row = row;
+    m_hOut = row < m_rout ? static_cast<long>(m_outer.GetHeight(row)) : -1;
+    m_hIn = (m_pInner && row < m_rin) ? static_cast<long>(m_pInner->GetHeight(row)) : -1;
+
+    // the outer edge's AA pixels are past the span: the row run's one, and the column run's
+    m_last = m_hOut;
+    if(row < m_m45out)
+    {
+      m_last = m_hOut + 1;
+    }
+    n = CountAAColumns(m_outer, m_m45out, 1, row);
+    if(n - 1 > m_last)
+    {
+      m_last = n - 1;
+    }
+
+    // ... and the hole's are inside it.
+    m_first = m_hIn + 1;
+    if(m_hIn >= 0)
+    {
+      if(row < m_m45in)
+      {
+        m_first = m_hIn;
+      }
+      n = CountAAColumns(*m_pInner, m_m45in, 0, row + 1);
+      if(n < m_m45in && n < m_first)
+      {
+        m_first = n;
+      }
+    }
+  }
+
+  long GetFirst() const { return m_first; }
+  long GetLast() const { return m_last; }
+  long GetCoreFirst() const { return m_hIn + 1; }
+  long GetCoreLast() const { return m_hOut; }
+
+  // 0-255 for any x in the row
+  BYTE GetCoverage(long x) const
+  {
+    long o = x <= m_hOut ? 255 : GetQuadrantAA(m_outer, m_m45out, 1, m_scaleOut, x, m_row);
+    long i = x > m_hIn ? 255 : GetQuadrantAA(*m_pInner, m_m45in, 0, m_scaleIn, x, m_row);
+    long c = o + i - 255;
+    return static_cast<BYTE>(c > 0 ? c : 0);
+  }
+
+private:
+  CircleAARow& operator=(const CircleAARow&);
+
+  const CircleHeightsAA<false>& m_outer;
+  const CircleHeightsAA<true>* m_pInner;
+  long m_rout;
+  long m_rin;
+  long m_m45out;
+  long m_m45in;
+  long m_scaleOut;
+  long m_scaleIn;
+
+  long m_row;
+  long m_hOut;
+  long m_hIn;
+  long m_first;
+  long m_last;
+};
+
+// every row of the quadrant worked out once, so it can be played back for both halves, and for
+// any number of shapes that use the same table(s) (see DrawCirclesAA() and ScanlineRenderer).
+class CircleRowList
+{
+public:
+  // with an arena the list is scratch for this frame; without, it's on the heap and can be kept.
+  explicit CircleRowList(FrameArena* pArena = 0) :
+    m_rows(pArena),
+    m_coverage(pArena)
+  {
+  }
+
+  // x's first..last of the row have something in them, coreFirst..coreLast of those are solid
+  // (none if coreFirst > coreLast), and the rest have a coverage in GetCoverage(): the ones
+  // before the core first, then the ones after it.
+  struct Row
+  {
+    long first;
+    long last;
+    long coreFirst;
+    long coreLast;
+    size_t coverage;
+  };
+
+  void Init(const CircleHeightsAA<false>& outer, const CircleHeightsAA<true>* pInner)
+  {
+    GEOM_ZONE("CircleRowList::Init");
+    CircleAARow row(outer, pInner);
+    long nRows = row.GetRowCount();
+    long x;
+    m_rows.resize(nRows > 0 ? nRows : 0);
+    m_coverage.clear();
+
+    for(long y = 0; y < nRows; y ++)
+    {
+      Row& r = m_rows[y];
+      row.SetRow(y);
+      r.first = row.GetFirst();
+      r.last = row.GetLast();
+      r.coreFirst = row.GetCoreFirst();
+      r.coreLast = row.GetCoreLast();
+      r.coverage = m_coverage.size();
+      if(r.coreFirst > r.coreLast)
+      {
+        // no core; call it all "before"
+        r.coreFirst = r.last + 1;
+        r.coreLast = r.last;
+      }
+
+      for(x = r.first; x < r.coreFirst; x ++)
+      {
+        m_coverage.push_back(row.GetCoverage(x));
+      }
+      for(x = r.coreLast + 1; x <= r.last; x ++)
+      {
+        m_coverage.push_back(row.GetCoverage(x));
+      }
+    }
+  }
+
+  // the same thing without AA, for the plain circles and donuts: just the spans.  pInner is 0
+  // for no hole.
+  void Init(const CircleHeights& outer, const CircleHeights* pInner)
+  {
+    GEOM_ZONE("CircleRowList::Init");
+    long nRows = outer.GetRadius();
+    long rin = pInner ? static_cast<long>(pInner->GetRadius()) : 0;
+    m_rows.resize(nRows);
+    m_coverage.clear();
+
+    for(long y = 0; y < nRows; y ++)
+    {
+      Row& r = m_rows[y];
+      r.coreFirst = y < rin ? pInner->GetHeight(y) + 1 : 0;
+      r.coreLast = outer.GetHeight(y);
+      if(r.coreFirst > r.coreLast)
+      {
+        r.coreFirst = 0;
+        r.coreLast = -1;
+      }
+      r.first = r.coreFirst;
+      r.last = r.coreLast;
+      r.coverage = 0;
+    }
+  }
+
+  long GetRowCount() const
+  {
+    return static_cast<long>(m_rows.size());
+  }
+
+  const Row& GetRow(long y) const
+  {
+    return m_rows[y];
+  }
+
+  const BYTE* GetCoverage(const Row& r) const
+  {
+    return m_coverage.empty() ? 0 : &m_coverage[r.coverage];
+  }
+
+private:
+  FrameVector<Row> m_rows;
+  FrameVector<BYTE> m_coverage;
+};
+
+// writes out quadrant row "r" at screen row y, both halves.
+template<typename Tsink>
+void AddCircleRow(const CircleRowList& rows, const CircleRowList::Row& r, long cx, long y, const ClipRect& clip, Tsink& sink)
+{
+  const BYTE* pBefore = rows.GetCoverage(r);
+  long nBefore = r.coreFirst - r.first;
+  const BYTE* pAfter = pBefore + nBefore;
+  long nAfter = r.last - r.coreLast;
+  bool bCore = r.coreFirst <= r.coreLast;
+  bool bJoin = bCore && (r.coreFirst == 0);// no hole on this row; one span straight across
+  long i;
+
+  // left half, so the quadrant goes backwards
+  for(i = nAfter - 1; i >= 0; i --)
+  {
+    if(pAfter[i])
+    {
+      AddClippedCoverage(sink, clip, cx - r.coreLast - i - 2, y, pAfter[i]);
+    }
+  }
+  if(bCore && !bJoin)
+  {
+    AddClippedSpan(sink, clip, cx - r.coreLast - 1, cx - r.coreFirst - 1, y);
+  }
+  for(i = nBefore - 1; i >= 0; i --)
+  {
+    if(pBefore[i])
+    {
+      AddClippedCoverage(sink, clip, cx - r.first - i - 1, y, pBefore[i]);
+    }
+  }
+
+  if(bJoin)
+  {
+    AddClippedSpan(sink, clip, cx - r.coreLast - 1, cx + r.coreLast, y);
+  }
+
+  for(i = 0; i < nBefore; i ++)
+  {
+    if(pBefore[i])
+    {
+      AddClippedCoverage(sink, clip, cx + r.first + i, y, pBefore[i]);
+    }
+  }
+  if(bCore && !bJoin)
+  {
+    AddClippedSpan(sink, clip, cx + r.coreFirst, cx + r.coreLast, y);
+  }
+  for(i = 0; i < nAfter; i ++)
+  {
+    if(pAfter[i])
+    {
+      AddClippedCoverage(sink, clip, cx + r.coreLast + i + 1, y, pAfter[i]);
+    }
+  }
+}
+
+template<typename Tsink>
+void CircleRows(const CircleRowList& rows, long cx, long cy, const ClipRect& clip, Tsink& sink)
+{
+  GEOM_ZONE("CircleRows");
+  long y0, y1;
+  long y;
+  GetClipRows(clip, cy, y0, y1);
+  if(y1 > rows.GetRowCount()) y1 = rows.GetRowCount();
+
+  // top half, from the top down
+  for(y = y1 - 1; y >= y0; y --)
+  {
+    if(cy - y - 1 >= clip.top && cy - y - 1 < clip.bottom)
+    {
+      AddCircleRow(rows, rows.GetRow(y), cx, cy - y - 1, clip, sink);
+    }
+  }
+
+  for(y = y0; y < y1; y ++)
+  {
+    if(cy + y >= clip.top && cy + y < clip.bottom)
+    {
+      AddCircleRow(rows, rows.GetRow(y), cx, cy + y, clip, sink);
+    }
+  }
+}
+
+
+template<typename Tsink>
+void FilledCircleAARows(const CircleHeightsAA<false>& heights, long cx, long cy, const ClipRect& clip, Tsink& sink, FrameArena* pArena = 0)
+{
+  FrameArena::Scope scope(pArena);
+  CircleRowList rows(pArena);
+  rows.Init(heights, 0);
+  CircleRows(rows, cx, cy, clip, sink);
+}
+
+
+template<typename Tsink>
+void DonutAARows(const CircleHeightsAA<false>& outer, const CircleHeightsAA<true>& inner, long cx, long cy, const ClipRect& clip, Tsink& sink, FrameArena* pArena = 0)
+{
+  FrameArena::Scope scope(pArena);
+  CircleRowList rows(pArena);
+  rows.Init(outer, &inner);
+  CircleRows(rows, cx, cy, clip, sink);
+}
+
+
+template<typename Tsink>
+void FilledCircleSpans(long cx, long cy, long r, const ClipRect& clip, Tsink& sink)
+{
+  std::shared_ptr<const CircleHeights> pHeights = GetCircleTable<CircleHeights>(r);
+  FilledCircleSpans(*pHeights, cx, cy, clip, sink);
+}
+
+template<typename Tsink>
+void FilledCircleSpans(long cx, long cy, long r, Tsink& sink)
+{
+  FilledCircleSpans(cx, cy, r, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void FilledCircleAASpans(long cx, long cy, long r, const ClipRect& clip, Tsink& sink)
+{
+  std::shared_ptr<const CircleHeightsAA<false> > pHeights = GetCircleTable<CircleHeightsAA<false> >(r);
+  FilledCircleAASpans(*pHeights, cx, cy, clip, sink);
+}
+
+template<typename Tsink>
+void FilledCircleAASpans(long cx, long cy, long r, Tsink& sink)
+{
+  FilledCircleAASpans(cx, cy, r, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void DonutSpans(long cx, long cy, long rin, long width, const ClipRect& clip, Tsink& sink)
+{
+  std::shared_ptr<const CircleHeights> pOuter = GetCircleTable<CircleHeights>(rin+width);
+  std::shared_ptr<const CircleHeights> pInner = GetCircleTable<CircleHeights>(rin);
+  DonutSpans(*pOuter, *pInner, cx, cy, clip, sink);
+}
+
+template<typename Tsink>
+void DonutSpans(long cx, long cy, long rin, long width, Tsink& sink)
+{
+  DonutSpans(cx, cy, rin, width, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void DonutAASpans(long cx, long cy, long rin, long width, const ClipRect& clip, Tsink& sink)
+{
+  std::shared_ptr<const CircleHeightsAA<false> > pOuter = GetCircleTable<CircleHeightsAA<false> >(rin+width);
+  std::shared_ptr<const CircleHeightsAA<true> > pInner = GetCircleTable<CircleHeightsAA<true> >(rin);
+  DonutAASpans(*pOuter, *pInner, cx, cy, clip, sink);
+}
+
+template<typename Tsink>
+void DonutAASpans(long cx, long cy, long rin, long width, Tsink& sink)
+{
+  DonutAASpans(cx, cy, rin, width, ClipRect::Everything(), sink);
+}
+
+
+// pArena (see framearena.h) is for the row list; 0 means the heap.
+template<typename Tsink>
+void FilledCircleAARows(long cx, long cy, long r, const ClipRect& clip, Tsink& sink, FrameArena* pArena = 0)
+{
+  std::shared_ptr<const CircleHeightsAA<false> > pHeights = GetCircleTable<CircleHeightsAA<false> >(r);
+  FilledCircleAARows(*pHeights, cx, cy, clip, sink, pArena);
+}
+
+template<typename Tsink>
+void FilledCircleAARows(long cx, long cy, long r, Tsink& sink)
+{
+  FilledCircleAARows(cx, cy, r, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void DonutAARows(long cx, long cy, long rin, long width, const ClipRect& clip, Tsink& sink, FrameArena* pArena = 0)
+{
+  std::shared_ptr<const CircleHeightsAA<false> > pOuter = GetCircleTable<CircleHeightsAA<false> >(rin+width);
+  std::shared_ptr<const CircleHeightsAA<true> > pInner = GetCircleTable<CircleHeightsAA<true> >(rin);
+  DonutAARows(*pOuter, *pInner, cx, cy, clip, sink, pArena);
+}
+
+template<typename Tsink>
+void DonutAARows(long cx, long cy, long rin, long width, Tsink& sink)
+{
+  DonutAARows(cx, cy, rin, width, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void FilledEllipseSpans(long cx, long cy, long rx, long ry, const ClipRect& clip, Tsink& sink)
+{
+  long y0, y1;
+  GetClipRows(clip, cy, y0, y1);
+  if(y1 > ry) y1 = ry;
+  if(y0 >= y1)
+  {
+    return;
+  }
+
+  EllipseHeights heights;
+  heights.Init(rx, ry);
+  EllipseHeights::Height_T w;
+
+  for(long y = y0; y < y1; ++ y)
+  {
+    w = heights.GetWidth(y);
+    if(w)
+    {
+      AddClippedSpan(sink, clip, cx - w, cx + w - 1, cy + y);
+      AddClippedSpan(sink, clip, cx - w, cx + w - 1, cy - y - 1);
+    }
+  }
+}
+
+template<typename Tsink>
+void FilledEllipseSpans(long cx, long cy, long rx, long ry, Tsink& sink)
+{
+  FilledEllipseSpans(cx, cy, rx, ry, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void FilledEllipseAASpans(long cx, long cy, long rx, long ry, const ClipRect& clip, Tsink& sink)
+{
+  // the AA pixels go one row past the spans
+  long y0, y1;
+  GetClipRows(clip, cy, y0, y1);
+  if(y0 > ry || !IsRunVisible(clip, cx, cy, 0, rx, 0, ry))
+  {
+    return;
+  }
+
+  EllipseHeightsAA heights;
+  heights.Init(rx, ry);
+  long yEnd = y1 < ry ? y1 : ry;
+  EllipseHeightsAA::Height_T w;
+
+  for(long y = y0; y < yEnd; ++ y)
+  {
+    w = heights.GetWidth(y);
+    if(w)
+    {
+      AddClippedSpan(sink, clip, cx - w, cx + w - 1, cy + y);
+      AddClippedSpan(sink, clip, cx - w, cx + w - 1, cy - y - 1);
+    }
+  }
+
+  // the values are already 0-255
+  long nRows = heights.GetRowAACount();
+  long nCols = heights.GetColumnAACount();
+  if(nRows > 0 && IsRunVisible(clip, cx, cy, heights.GetWidth(nRows - 1), heights.GetWidth(0), 0, nRows - 1))
+  {
+    yEnd = y1 < nRows ? y1 : nRows;
+    for(long y = y0; y < yEnd; ++ y)
+    {
+      AddCoverage4(sink, clip, cx, cy, heights.GetWidth(y), y, static_cast<BYTE>(heights.GetRowAAValue(y)));
+    }
+  }
+
+  if(nCols > 0 && IsRunVisible(clip, cx, cy, 0, nCols - 1, heights.GetColumnAAHeight(nCols - 1), heights.GetColumnAAHeight(0)))
+  {
+    for(long x = 0; x < nCols; ++ x)
+    {
+      AddCoverage4(sink, clip, cx, cy, x, heights.GetColumnAAHeight(x), static_cast<BYTE>(heights.GetColumnAAValue(x)));
+    }
+  }
+}
+
+template<typename Tsink>
+void FilledEllipseAASpans(long cx, long cy, long rx, long ry, Tsink& sink)
+{
+  FilledEllipseAASpans(cx, cy, rx, ry, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void EllipseRingSpans(long cx, long cy, long rxin, long ryin, long width, const ClipRect& clip, Tsink& sink)
+{
+  long y0, y1;
+  GetClipRows(clip, cy, y0, y1);
+  if(y1 > ryin + width) y1 = ryin + width;
+  if(y0 >= y1)
+  {
+    return;
+  }
+
+  EllipseHeights outer;
+  EllipseHeights inner;
+  outer.Init(rxin + width, ryin + width);
+  inner.Init(rxin, ryin);
+
+  long yEnd = y1 < inner.GetRadiusY() ? y1 : inner.GetRadiusY();
+  long y;
+  EllipseHeights::Height_T wOuter;
+  EllipseHeights::Height_T wInner;
+
+  for(y = y0; y < yEnd; y ++)
+  {
+    wOuter = outer.GetWidth(y);
+    wInner = inner.GetWidth(y);
+    if(wOuter > wInner)
+    {
+      AddClippedSpan(sink, clip, cx + wInner, cx + wOuter - 1, cy + y);
+      AddClippedSpan(sink, clip, cx + wInner, cx + wOuter - 1, cy - y - 1);
+      AddClippedSpan(sink, clip, cx - wOuter, cx - wInner - 1, cy + y);
+      AddClippedSpan(sink, clip, cx - wOuter, cx - wInner - 1, cy - y - 1);
+    }
+  }
+
+  for(y = y0 > inner.GetRadiusY() ? y0 : inner.GetRadiusY(); y < y1; ++ y)
+  {
+    wOuter = outer.GetWidth(y);
+    if(wOuter)
+    {
+      AddClippedSpan(sink, clip, cx - wOuter, cx + wOuter - 1, cy + y);
+      AddClippedSpan(sink, clip, cx - wOuter, cx + wOuter - 1, cy - y - 1);
+    }
+  }
+}
+
+template<typename Tsink>
+void EllipseRingSpans(long cx, long cy, long rxin, long ryin, long width, Tsink& sink)
+{
+  EllipseRingSpans(cx, cy, rxin, ryin, width, ClipRect::Everything(), sink);
+}
+
+
+/*
+  Clipped versions of the *G functions.  These go through the *Spans code above, so the same
+  rows and AA runs get skipped.  The span callback is the same as always (both ends inclusive,
+  now never outside the clip).  The AA callback is different: since the 4 mirrors of a pixel
+  can be clipped separately, it gets one real pixel at a time, and f is always out of 255:
+
+    void aproc(long x, long y, long f, long fmax);
+
+  so the AA ones are FilledCircleAAClippedG() etc. rather than more FilledCircleAAG() overloads;
+  the mirrored aproc(cx, cy, x, y, f, fmax) of FilledCircleAAG() won't go in them.  The
+  AARowsG, LineAAG and ThickLineAAG functions below take this one-pixel callback too.
+*/
+
+// calls the span callback for every span.
+template<typename Tsh, typename Tshproc>
+class SpanCallbackSink
+{
+public:
+  SpanCallbackSink(Tsh sh, Tshproc shproc) :
+    m_sh(sh),
+    m_shproc(shproc)
+  {
+  }
+
+  inline void AddSpan(long x1, long x2, long y)
+  {
+    (m_sh->*m_shproc)(x1, x2, y);
+  }
+
+private:
+  Tsh m_sh;
+  Tshproc m_shproc;
+};
+
+// ... and the one-pixel AA callback, aproc(x, y, c, 255), for every AA pixel.
+template<typename Tsh, typename Tshproc, typename Ta, typename Taproc>
+class AACallbackSink : public SpanCallbackSink<Tsh, Tshproc>
+{
+public:
+  AACallbackSink(Tsh sh, Tshproc shproc, Ta a, Taproc aproc) :
+    SpanCallbackSink<Tsh, Tshproc>(sh, shproc),
+    m_a(a),
+    m_aproc(aproc)
+  {
+  }
+
+  inline void AddCoverage(long x, long y, BYTE c)
+  {
+    (m_a->*m_aproc)(x, y, c, 255);
+  }
+
+private:
+  Ta m_a;
+  Taproc m_aproc;
+};
+
+
+template<typename Tsh, typename Tshproc>
+void FilledCircleG(long cx, long cy, long r, const ClipRect& clip, Tsh sh, Tshproc shproc)
+{
+  SpanCallbackSink<Tsh, Tshproc> sink(sh, shproc);
+  FilledCircleSpans(cx, cy, r, clip, sink);
+}
+
+
+template<typename Tsh, typename Tshproc, typename Ta, typename Taproc>
+void FilledCircleAAClippedG(long cx, long cy, long r, const ClipRect& clip, Tsh sh, Tshproc shproc, Ta a, Taproc aproc)
+{
+  AACallbackSink<Tsh, Tshproc, Ta, Taproc> sink(sh, shproc, a, aproc);
+  FilledCircleAASpans(cx, cy, r, clip, sink);
+}
+
+
+template<typename Th, typename Thproc>
+void DonutG(long cx, long cy, long rin, long width, const ClipRect& clip, Th h, Thproc hproc)
+{
+  SpanCallbackSink<Th, Thproc> sink(h, hproc);
+  DonutSpans(cx, cy, rin, width, clip, sink);
+}
+
+
+template<typename Th, typename Thproc, typename Ta, typename Taproc>
+void DonutAAClippedG(long cx, long cy, long rin, long width, const ClipRect& clip, Th h, Thproc hproc, Ta a, Taproc aproc)
+{
+  AACallbackSink<Th, Thproc, Ta, Taproc> sink(h, hproc, a, aproc);
+  DonutAASpans(cx, cy, rin, width, clip, sink);
+}
+
+
+// single pass (see FilledCircleAARows() / DonutAARows()): every pixel gets exactly one callback.
+template<typename Tsh, typename Tshproc, typename Ta, typename Taproc>
+void FilledCircleAARowsG(long cx, long cy, long r, const ClipRect& clip, Tsh sh, Tshproc shproc, Ta a, Taproc aproc, FrameArena* pArena = 0)
+{
+  AACallbackSink<Tsh, Tshproc, Ta, Taproc> sink(sh, shproc, a, aproc);
+  FilledCircleAARows(cx, cy, r, clip, sink, pArena);
+}
+
+template<typename Tsh, typename Tshproc, typename Ta, typename Taproc>
+void FilledCircleAARowsG(long cx, long cy, long r, Tsh sh, Tshproc shproc, Ta a, Taproc aproc)
+{
+  FilledCircleAARowsG(cx, cy, r, ClipRect::Everything(), sh, shproc, a, aproc);
+}
+
+
+template<typename Th, typename Thproc, typename Ta, typename Taproc>
+void DonutAARowsG(long cx, long cy, long rin, long width, const ClipRect& clip, Th h, Thproc hproc, Ta a, Taproc aproc, FrameArena* pArena = 0)
+{
+  AACallbackSink<Th, Thproc, Ta, Taproc> sink(h, hproc, a, aproc);
+  DonutAARows(cx, cy, rin, width, clip, sink, pArena);
+}
+
+template<typename Th, typename Thproc, typename Ta, typename Taproc>
+void DonutAARowsG(long cx, long cy, long rin, long width, Th h, Thproc hproc, Ta a, Taproc aproc)
+{
+  DonutAARowsG(cx, cy, rin, width, ClipRect::Everything(), h, hproc, a, aproc);
+}
+
+
+template<typename Tsh, typename Tshproc>
+void FilledEllipseG(long cx, long cy, long rx, long ry, const ClipRect& clip, Tsh sh, Tshproc shproc)
+{
+  SpanCallbackSink<Tsh, Tshproc> sink(sh, shproc);
+  FilledEllipseSpans(cx, cy, rx, ry, clip, sink);
+}
+
+
+template<typename Tsh, typename Tshproc, typename Ta, typename Taproc>
+void FilledEllipseAAClippedG(long cx, long cy, long rx, long ry, const ClipRect& clip, Tsh sh, Tshproc shproc, Ta a, Taproc aproc)
+{
+  AACallbackSink<Tsh, Tshproc, Ta, Taproc> sink(sh, shproc, a, aproc);
+  FilledEllipseAASpans(cx, cy, rx, ry, clip, sink);
+}
+
+
+template<typename Th, typename Thproc>
+void EllipseRingG(long cx, long cy, long rxin, long ryin, long width, const ClipRect& clip, Th h, Thproc hproc)
+{
+  SpanCallbackSink<Th, Thproc> sink(h, hproc);
+  EllipseRingSpans(cx, cy, rxin, ryin, width, clip, sink);
+}
+
+
+/*
+  Lines.  Endpoints are pixels, and both of them get drawn.
+
+  LineG is plain bresenham.  Pixels that end up on the same row come out as one span, so mostly
+  horizontal lines go through HLine instead of pixel by pixel.
+
+  LineAAG is Wu's: a pair of pixels across the line at every step, with coverages that add up to
+  255.  Everything is an AA pixel; there are no spans.
+
+  ThickLineAAG draws the line as a rectangle "width" pixels across with square ends, the end
+  points being the middle of the two short sides.  Every row comes out as one solid span with AA
+  pixels on each end, so the insides go through the fast fills.
+
+  The *G versions take the span callback the circles use and the one-pixel-at-a-time AA callback
+  of the *AAClippedG functions, aproc(x, y, f, fmax).  Everything is integer / fixed point.
+*/
+
+inline long GeomAbs(long n)
+{
+  return n < 0 ? -n : n;
+}
+
+// floor(sqrt(n))
+inline LONGLONG GeomISqrt(LONGLONG n)
+{
+  LONGLONG r = 0;
+  LONGLONG bit = 1LL << 62;
+  while(bit > n)
+  {
+    bit >>= 2;
+  }
+  while(bit != 0)
+  {
+    if(n >= r + bit)
+    {
+      n -= r + bit;
+      r = (r >> 1) + bit;
+    }
+    else
+    {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return r;
+}
+
+// is the box x0..x1, y0..y1 (inclusive) anywhere in the clip?
+inline bool IsBoxVisible(const ClipRect& clip, long x0, long y0, long x1, long y1)
+{
+  return (x1 >= clip.left) && (x0 < clip.right) && (y1 >= clip.top) && (y0 < clip.bottom);
+}
+
+
+template<typename Tsink>
+void LineSpans(long x1, long y1, long x2, long y2, const ClipRect& clip, Tsink& sink)
+{
+  if(!IsBoxVisible(clip, x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2, x1 < x2 ? x2 : x1, y1 < y2 ? y2 : y1))
+  {
+    return;
+  }
+
+  long dx = GeomAbs(x2 - x1);
+  long dy = GeomAbs(y2 - y1);
+  long sx = x1 < x2 ? 1 : -1;
+  long sy = y1 < y2 ? 1 : -1;
+  long x = x1;
+  long y = y1;
+
+  if(dx >= dy)
+  {
+    // mostly horizontal; collect the pixels on each row into one span
+    long d = (2 * dy) - dx;
+    long xRun = x1;
+    for(long i = 0; i < dx; i ++)
+    {
+      if(d > 0)
+      {
+        AddClippedSpan(sink, clip, xRun < x ? xRun : x, xRun < x ? x : xRun, y);
+        y += sy;
+        d -= 2 * dx;
+        xRun = x + sx;
+      }
+      d += 2 * dy;
+      x += sx;
+    }
+    AddClippedSpan(sink, clip, xRun < x ? xRun : x, xRun < x ? x : xRun, y);
+  }
+  else
+  {
+    long d = (2 * dx) - dy;
+    for(long i = 0; i <= dy; i ++)
+    {
+      AddClippedSpan(sink, clip, x, x, y);
+      if(d > 0)
+      {
+        x += sx;
+        d -= 2 * dy;
+      }
+      d += 2 * dx;
+      y += sy;
+    }
+  }
+}
+
+
+template<typename Tsink>
+void LineAASpans(long x1, long y1, long x2, long y2, const ClipRect& clip, Tsink& sink)
+{
+  // the pixels go one past the end points across the line
+  if(!IsBoxVisible(clip, (x1 < x2 ? x1 : x2) - 1, (y1 < y2 ? y1 : y2) - 1, (x1 < x2 ? x2 : x1) + 1, (y1 < y2 ? y2 : y1) + 1))
+  {
+    return;
+  }
+
+  long dx = x2 - x1;
+  long dy = y2 - y1;
+  bool bSteep = GeomAbs(dy) > GeomAbs(dx);
+
+  // walk the major axis (u) from low to high, stepping the minor one (v) in 16.16
+  long u1 = bSteep ? y1 : x1;
+  long u2 = bSteep ? y2 : x2;
+  long v1 = bSteep ? x1 : y1;
+  long v2 = bSteep ? x2 : y2;
+  if(u1 > u2)
+  {
+    long t;
+    t = u1; u1 = u2; u2 = t;
+    t = v1; v1 = v2; v2 = t;
+  }
+
+  long du = u2 - u1;
+  long gradient = du > 0 ? static_cast<long>((static_cast<LONGLONG>(v2 - v1) << 16) / du) : 0;
+
+  // only the part of the major axis inside the clip
+  long uStart = u1;
+  long uEnd = u2;
+  long uClip0 = bSteep ? clip.top : clip.left;
+  long uClip1 = (bSteep ? clip.bottom : clip.right) - 1;
+  if(uStart < uClip0) uStart = uClip0;
+  if(uEnd > uClip1) uEnd = uClip1;
+
+  LONGLONG v = (static_cast<LONGLONG>(v1) << 16) + (static_cast<LONGLONG>(uStart - u1) * gradient);
+  for(long u = uStart; u <= uEnd; u ++)
+  {
+    long vi = static_cast<long>(v >> 16);
+    BYTE c = static_cast<BYTE>((v >> 8) & 0xFF);
+    if(bSteep)
+    {
+      AddClippedCoverage(sink, clip, vi, u, static_cast<BYTE>(255 - c));
+      if(c) AddClippedCoverage(sink, clip, vi + 1, u, c);
+    }
+    else
+    {
+      AddClippedCoverage(sink, clip, u, vi, static_cast<BYTE>(255 - c));
+      if(c) AddClippedCoverage(sink, clip, u, vi + 1, c);
+    }
+    v += gradient;
+  }
+}
+
+
+// how much of a pixel is on the inside of a straight edge, 0 to 1 in 16.16.  d is how far the
+// pixel center is inside the edge, p and q are the edge's unit normal with the signs dropped and
+// p >= q.  exact, since a line can only cut a square a few ways.
+inline LONGLONG EdgeCoverage(LONGLONG d, LONGLONG p, LONGLONG q)
+{
+  const LONGLONG One = 1 << 16;
+  LONGLONG e = (p + q) >> 1;// past this it's all or nothing
+  LONGLONG f = (p - q) >> 1;// inside this the edge crosses both of the far sides
+  LONGLONG r;
+  if(d <= -e)
+  {
+    r = 0;
+  }
+  else if(d >= e)
+  {
+    r = One;
+  }
+  else if(d <= f && d >= -f)
+  {
+    r = (One >> 1) + ((d * One) / p);
+  }
+  else if(d < 0)
+  {
+    // just one corner of the pixel is inside
+    r = ((d + e) * (d + e)) / ((2 * p * q) >> 16);
+  }
+  else
+  {
+    r = One - (((e - d) * (e - d)) / ((2 * p * q) >> 16));
+  }
+  return r < 0 ? 0 : (r > One ? One : r);
+}
+
+// x range of a convex polygon (16.16 points) at height y.  returns false if y misses it.
+inline bool PolygonXRange(const LONGLONG* px, const LONGLONG* py, long n, LONGLONG y, LONGLONG& lo, LONGLONG& hi)
+{
+  bool r = false;
+  for(long i = 0; i < n; i ++)
+  {
+    long j = (i + 1) % n;
+    LONGLONG ya = py[i], yb = py[j];
+    if((y < ya && y < yb) || (y > ya && y > yb))
+    {
+      continue;
+    }
+
+    LONGLONG x0, x1;
+    if(ya == yb)
+    {
+      x0 = px[i];
+      x1 = px[j];
+    }
+    else
+    {
+      x0 = px[i] + (((y - ya) * (px[j] - px[i])) / (yb - ya));
+      x1 = x0;
+    }
+
+    if(!r)
+    {
+      lo = x0 < x1 ? x0 : x1;
+      hi = x0 < x1 ? x1 : x0;
+      r = true;
+    }
+    else
+    {
+      if(x0 < lo) lo = x0;
+      if(x1 < lo) lo = x1;
+      if(x0 > hi) hi = x0;
+      if(x1 > hi) hi = x1;
+    }
+  }
+  return r;
+}
+
+
+// the line is two slabs crossing: "width" across and the line's length along.  AA pixels get the
+// product of how much of them is inside each slab, which is exact along the sides and very close
+// at the corners.
+template<typename Tsink>
+void ThickLineAASpans(long x1, long y1, long x2, long y2, long width, const ClipRect& clip, Tsink& sink)
+{
+  const LONGLONG One = 1 << 16;
+  if(width < 1)
+  {
+    width = 1;
+  }
+
+  // direction (ux, uy) and its normal (-uy, ux) in 16.16.  the length is in 17.15 so it all fits
+  // with dx, dy up to 32767.  a single point is a width x width square.
+  long dx = x2 - x1;
+  long dy = y2 - y1;
+  LONGLONG len = GeomISqrt(((static_cast<LONGLONG>(dx) * dx) + (static_cast<LONGLONG>(dy) * dy)) << 30);
+  LONGLONG ux = One;
+  LONGLONG uy = 0;
+  LONGLONG halfw = static_cast<LONGLONG>(width) << 15;
+  LONGLONG halfl = halfw;
+  if(len != 0)
+  {
+    ux = (static_cast<LONGLONG>(dx) << 31) / len;
+    uy = (static_cast<LONGLONG>(dy) << 31) / len;
+    halfl = len;// 17.15 of the whole length is 16.16 of half of it
+  }
+  LONGLONG p = ux < 0 ? -ux : ux;
+  LONGLONG q = uy < 0 ? -uy : uy;
+  if(q > p)
+  {
+    LONGLONG t = p; p = q; q = t;
+  }
+
+  // middle of the line, pixel centers at +0.5
+  LONGLONG mx = ((static_cast<LONGLONG>(x1) + x2) << 15) + (One >> 1);
+  LONGLONG my = ((static_cast<LONGLONG>(y1) + y2) << 15) + (One >> 1);
+
+  // the corners
+  LONGLONG ax = mx - ((ux * halfl) >> 16), ay = my - ((uy * halfl) >> 16);
+  LONGLONG bx = mx + ((ux * halfl) >> 16), by = my + ((uy * halfl) >> 16);
+  LONGLONG nx = (-uy * halfw) >> 16, ny = (ux * halfw) >> 16;
+  LONGLONG px[4] = { ax + nx, bx + nx, bx - nx, ax - nx };
+  LONGLONG py[4] = { ay + ny, by + ny, by - ny, ay - ny };
+
+  LONGLONG ymin = py[0], ymax = py[0];
+  LONGLONG xmin = px[0], xmax = px[0];
+  for(long i = 1; i < 4; i ++)
+  {
+    if(py[i] < ymin) ymin = py[i];
+    if(py[i] > ymax) ymax = py[i];
+    if(px[i] < xmin) xmin = px[i];
+    if(px[i] > xmax) xmax = px[i];
+  }
+
+  // only the rows inside the clip
+  long row0 = static_cast<long>(ymin >> 16);
+  long row1 = static_cast<long>((ymax + One - 1) >> 16);
+  if(row0 < clip.top) row0 = clip.top;
+  if(row1 > clip.bottom) row1 = clip.bottom;
+  if(!IsBoxVisible(clip, static_cast<long>(xmin >> 16), row0, static_cast<long>(xmax >> 16), row1 - 1))
+  {
+    return;
+  }
+
+  for(long row = row0; row < row1; row ++)
+  {
+    // the x range the polygon covers in this row, and the part of it that's inside all the way
+    // from the top of the row to the bottom.
+    LONGLONG yt = static_cast<LONGLONG>(row) << 16;
+    LONGLONG yb = yt + One;
+    bool bFullRow = (yt >= ymin) && (yb <= ymax);
+    if(yt < ymin) yt = ymin;
+    if(yb > ymax) yb = ymax;
+
+    LONGLONG loT, hiT, loB, hiB;
+    if(yt >= yb || !PolygonXRange(px, py, 4, yt, loT, hiT) || !PolygonXRange(px, py, 4, yb, loB, hiB))
+    {
+      continue;
+    }
+    LONGLONG outerL = loT < loB ? loT : loB;
+    LONGLONG outerR = hiT > hiB ? hiT : hiB;
+    for(long i = 0; i < 4; i ++)
+    {
+      if(py[i] > yt && py[i] < yb)
+      {
+        if(px[i] < outerL) outerL = px[i];
+        if(px[i] > outerR) outerR = px[i];
+      }
+    }
+
+    long solid0 = static_cast<long>((((loT > loB) ? loT : loB) + One - 1) >> 16);
+    long solid1 = static_cast<long>(((hiT < hiB) ? hiT : hiB) >> 16) - 1;
+    if(!bFullRow)
+    {
+      solid0 = 1;
+      solid1 = 0;
+    }
+
+    long xFrom = static_cast<long>(outerL >> 16);
+    long xTo = static_cast<long>((outerR + One - 1) >> 16) - 1;
+    if(xFrom < clip.left) xFrom = clip.left;
+    if(xTo > clip.right - 1) xTo = clip.right - 1;
+
+    // distance of the first pixel center from the middle, along and across the line
+    LONGLONG cx0 = (static_cast<LONGLONG>(xFrom) << 16) + (One >> 1) - mx;
+    LONGLONG cy0 = (static_cast<LONGLONG>(row) << 16) + (One >> 1) - my;
+    LONGLONG along = ((cx0 * ux) + (cy0 * uy)) >> 16;
+    LONGLONG across = ((cy0 * ux) - (cx0 * uy)) >> 16;
+
+    for(long x = xFrom; x <= xTo; x ++, along += ux, across -= uy)
+    {
+      if(x >= solid0 && x <= solid1)
+      {
+        along += ux * (solid1 - x);
+        across -= uy * (solid1 - x);
+        AddClippedSpan(sink, clip, x, solid1, row);
+        x = solid1;
+        continue;
+      }
+
+      LONGLONG ca = EdgeCoverage(halfw - across, p, q) + EdgeCoverage(halfw + across, p, q) - One;
+      LONGLONG cl = EdgeCoverage(halfl - along, p, q) + EdgeCoverage(halfl + along, p, q) - One;
+      if(ca <= 0 || cl <= 0)
+      {
+        continue;
+      }
+      LONGLONG c = (((ca * cl) >> 16) * 255 + (One >> 1)) >> 16;
+      if(c > 0)
+      {
+        sink.AddCoverage(x, row, static_cast<BYTE>(c));
+      }
+    }
+  }
+}
+
+
+template<typename Tsink>
+void LineSpans(long x1, long y1, long x2, long y2, Tsink& sink)
+{
+  LineSpans(x1, y1, x2, y2, ClipRect::Everything(), sink);
+}
+
+template<typename Tsink>
+void LineAASpans(long x1, long y1, long x2, long y2, Tsink& sink)
+{
+  LineAASpans(x1, y1, x2, y2, ClipRect::Everything(), sink);
+}
+
+template<typename Tsink>
+void ThickLineAASpans(long x1, long y1, long x2, long y2, long width, Tsink& sink)
+{
+  ThickLineAASpans(x1, y1, x2, y2, width, ClipRect::Everything(), sink);
+}
+
+
+// only the AA callback, for LineAAG.
+template<typename Ta, typename Taproc>
+class PixelCallbackSink
+{
+public:
+  PixelCallbackSink(Ta a, Taproc aproc) :
+    m_a(a),
+    m_aproc(aproc)
+  {
+  }
+
+  inline void AddCoverage(long x, long y, BYTE c)
+  {
+    (m_a->*m_aproc)(x, y, c, 255);
+  }
+
+private:
+  Ta m_a;
+  Taproc m_aproc;
+};
+
+
+template<typename Tsh, typename Tshproc>
+void LineG(long x1, long y1, long x2, long y2, const ClipRect& clip, Tsh sh, Tshproc shproc)
+{
+  SpanCallbackSink<Tsh, Tshproc> sink(sh, shproc);
+  LineSpans(x1, y1, x2, y2, clip, sink);
+}
+
+template<typename Tsh, typename Tshproc>
+void LineG(long x1, long y1, long x2, long y2, Tsh sh, Tshproc shproc)
+{
+  LineG(x1, y1, x2, y2, ClipRect::Everything(), sh, shproc);
+}
+
+
+template<typename Ta, typename Taproc>
+void LineAAG(long x1, long y1, long x2, long y2, const ClipRect& clip, Ta a, Taproc aproc)
+{
+  PixelCallbackSink<Ta, Taproc> sink(a, aproc);
+  LineAASpans(x1, y1, x2, y2, clip, sink);
+}
+
+template<typename Ta, typename Taproc>
+void LineAAG(long x1, long y1, long x2, long y2, Ta a, Taproc aproc)
+{
+  LineAAG(x1, y1, x2, y2, ClipRect::Everything(), a, aproc);
+}
+
+
+template<typename Tsh, typename Tshproc, typename Ta, typename Taproc>
+void ThickLineAAG(long x1, long y1, long x2, long y2, long width, const ClipRect& clip, Tsh sh, Tshproc shproc, Ta a, Taproc aproc)
+{
+  AACallbackSink<Tsh, Tshproc, Ta, Taproc> sink(sh, shproc, a, aproc);
+  ThickLineAASpans(x1, y1, x2, y2, width, clip, sink);
+}
+
+template<typename Tsh, typename Tshproc, typename Ta, typename Taproc>
+void ThickLineAAG(long x1, long y1, long x2, long y2, long width, Tsh sh, Tshproc shproc, Ta a, Taproc aproc)
+{
+  ThickLineAAG(x1, y1, x2, y2, width, ClipRect::Everything(), sh, shproc, a, aproc);
+}
+
+
+/*
+  Band-parallel versions.  The shape's rows are cut into horizontal bands and the bands are run
+  on a ThreadPool.  Every band reads the same table (looked up once, up front) and draws with
+  its rows as the clip, so it skips everything outside them, and no two threads ever write the
+  same row.
+
+  Each band gets its own copy of "sink".  The sink has to be cheap to copy and safe to use from
+  several threads at once as long as the rows are different - something that draws straight into
+  a bitmap is fine, a SpanBuffer is not.
+
+  Small shapes aren't worth waking the pool for; below GEOM_MinBandRows rows per band they just
+  run on the calling thread.
+*/
+
+const long GEOM_MinBandRows = 32;
+// bands per thread.  more than 1 so the fat middle bands of a circle don't hold everyone up.
+const long GEOM_BandsPerThread = 4;
+
+// how many bands to cut "rows" rows into.
+inline long GetBandCount(ThreadPool& pool, long rows)
+{
+  long n = pool.GetThreadCount() * GEOM_BandsPerThread;
+  long nMax = rows / GEOM_MinBandRows;
+  if(n > nMax) n = nMax;
+  if(n < 1) n = 1;
+  return n;
+}
+
+// runs draw(bandclip, bandsink) for every band of rows top..bottom-1 that's inside clip.
+template<typename Tsink, typename Tdraw>
+void RunBands(ThreadPool& pool, long top, long bottom, const ClipRect& clip, const Tsink& sink, const Tdraw& draw)
+{
+  if(top < clip.top) top = clip.top;
+  if(bottom > clip.bottom) bottom = clip.bottom;
+  long rows = bottom - top;
+  if(rows < 1)
+  {
+    return;
+  }
+  long nBands = GetBandCount(pool, rows);
+
+  pool.Run(nBands, [&](long band)
+  {
+    Tsink bandsink(sink);
+    ClipRect bandclip = MakeClipRect(clip.left, top + ((rows * band) / nBands), clip.right, top + ((rows * (band + 1)) / nBands));
+    draw(bandclip, bandsink);
+  });
+}
+
+
+template<typename Tsink>
+void FilledCircleSpansBands(ThreadPool& pool, long cx, long cy, long r, const ClipRect& clip, const Tsink& sink)
+{
+  std::shared_ptr<const CircleHeights> pHeights = GetCircleTable<CircleHeights>(r);
+  const CircleHeights& heights = *pHeights;
+  RunBands(pool, cy - r, cy + r, clip, sink, [&](const ClipRect& bandclip, Tsink& b)
+  {
+    FilledCircleSpans(heights, cx, cy, bandclip, b);
+  });
+}
+
+template<typename Tsink>
+void FilledCircleSpansBands(ThreadPool& pool, long cx, long cy, long r, const Tsink& sink)
+{
+  FilledCircleSpansBands(pool, cx, cy, r, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void FilledCircleAASpansBands(ThreadPool& pool, long cx, long cy, long r, const ClipRect& clip, const Tsink& sink)
+{
+  std::shared_ptr<const CircleHeightsAA<false> > pHeights = GetCircleTable<CircleHeightsAA<false> >(r);
+  const CircleHeightsAA<false>& heights = *pHeights;
+  // the AA pixels reach one row past the spans
+  RunBands(pool, cy - r - 1, cy + r + 1, clip, sink, [&](const ClipRect& bandclip, Tsink& b)
+  {
+    FilledCircleAASpans(heights, cx, cy, bandclip, b);
+  });
+}
+
+template<typename Tsink>
+void FilledCircleAASpansBands(ThreadPool& pool, long cx, long cy, long r, const Tsink& sink)
+{
+  FilledCircleAASpansBands(pool, cx, cy, r, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void DonutSpansBands(ThreadPool& pool, long cx, long cy, long rin, long width, const ClipRect& clip, const Tsink& sink)
+{
+  std::shared_ptr<const CircleHeights> pOuter = GetCircleTable<CircleHeights>(rin+width);
+  std::shared_ptr<const CircleHeights> pInner = GetCircleTable<CircleHeights>(rin);
+  const CircleHeights& outer = *pOuter;
+  const CircleHeights& inner = *pInner;
+  long rout = rin + width;
+  RunBands(pool, cy - rout, cy + rout, clip, sink, [&](const ClipRect& bandclip, Tsink& b)
+  {
+    DonutSpans(outer, inner, cx, cy, bandclip, b);
+  });
+}
+
+template<typename Tsink>
+void DonutSpansBands(ThreadPool& pool, long cx, long cy, long rin, long width, const Tsink& sink)
+{
+  DonutSpansBands(pool, cx, cy, rin, width, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void DonutAASpansBands(ThreadPool& pool, long cx, long cy, long rin, long width, const ClipRect& clip, const Tsink& sink)
+{
+  std::shared_ptr<const CircleHeightsAA<false> > pOuter = GetCircleTable<CircleHeightsAA<false> >(rin+width);
+  std::shared_ptr<const CircleHeightsAA<true> > pInner = GetCircleTable<CircleHeightsAA<true> >(rin);
+  const CircleHeightsAA<false>& outer = *pOuter;
+  const CircleHeightsAA<true>& inner = *pInner;
+  long rout = rin + width;
+  RunBands(pool, cy - rout - 1, cy + rout + 1, clip, sink, [&](const ClipRect& bandclip, Tsink& b)
+  {
+    DonutAASpans(outer, inner, cx, cy, bandclip, b);
+  });
+}
+
+template<typename Tsink>
+void DonutAASpansBands(ThreadPool& pool, long cx, long cy, long rin, long width, const Tsink& sink)
+{
+  DonutAASpansBands(pool, cx, cy, rin, width, ClipRect::Everything(), sink);
+}
+
+
+/*
+  Batches.  DrawCircles() / DrawDonuts() and their AA versions draw a whole array of shapes into
+  one sink.  Drawing them one call at a time means a table lookup per shape (a lock and a linear
+  scan of the cache's entries), and for the AA ones working out the rows again every time.  Here
+  every size in the batch is looked up and worked out once, up front, and every shape of that size
+  is drawn off the same tables.  Shapes that can't touch the clip are dropped first.
+
+  The sort keys and row lists are scratch for the call: heap memory, or pArena's if there is one
+  (see framearena.h).
+
+  Then the shapes are drawn sorted top to bottom, left to right, whatever their size, and each
+  one comes out a row at a time from its top down (the AA ones through the *AARows() single pass
+  code), so memory gets walked forwards instead of from both ends of every shape at once.
+
+  That means the shapes aren't drawn in the order given (ties keep it, though).  It only matters
+  if they overlap and the sink's blend isn't order independent.
+*/
+
+struct CircleInstance
+{
+  long cx;
+  long cy;
+  long r;
+};
+
+struct DonutInstance
+{
+  long cx;
+  long cy;
+  long rin;
+  long width;
+};
+
+
+// row order versions of FilledCircleSpans() / DonutSpans(): top row first.
+template<typename Tsink>
+void FilledCircleRows(const CircleHeights& heights, long cx, long cy, const ClipRect& clip, Tsink& sink)
+{
+  long r = heights.GetRadius();
+  long y0, y1;
+  long y;
+  CircleHeights::Height_T h;
+  GetClipRows(clip, cy, y0, y1);
+  if(y1 > r) y1 = r;
+
+  for(y = y1 - 1; y >= y0; y --)
+  {
+    h = heights.GetHeight(y);
+    AddClippedSpan(sink, clip, cx - h - 1, cx + h, cy - y - 1);
+  }
+
+  for(y = y0; y < y1; y ++)
+  {
+    h = heights.GetHeight(y);
+    AddClippedSpan(sink, clip, cx - h - 1, cx + h, cy + y);
+  }
+}
+
+template<typename Tsink>
+inline void AddDonutRow(const CircleHeights& outer, const CircleHeights& inner, long cx, long y, long row, const ClipRect& clip, Tsink& sink)
+{
+  CircleHeights::Height_T hOuter = outer.GetHeight(y);
+  CircleHeights::Height_T hInner;
+  if(y < inner.GetRadius())
+  {
+    hInner = inner.GetHeight(y);
+    AddClippedSpan(sink, clip, cx - 1 - hOuter, cx - hInner - 2, row);
+    AddClippedSpan(sink, clip, cx + hInner + 1, cx + hOuter, row);
+  }
+  else
+  {
+    AddClippedSpan(sink, clip, cx - 1 - hOuter, cx + hOuter, row);
+  }
+}
+
+template<typename Tsink>
+void DonutRows(const CircleHeights& outer, const CircleHeights& inner, long cx, long cy, const ClipRect& clip, Tsink& sink)
+{
+  long rout = outer.GetRadius();
+  long y0, y1;
+  long y;
+  GetClipRows(clip, cy, y0, y1);
+  if(y1 > rout) y1 = rout;
+
+  for(y = y1 - 1; y >= y0; y --)
+  {
+    AddDonutRow(outer, inner, cx, y, cy - y - 1, clip, sink);
+  }
+
+  for(y = y0; y < y1; y ++)
+  {
+    AddDonutRow(outer, inner, cx, y, cy + y, clip, sink);
+  }
+}
+
+
+// a sort key and where the instance it's for is in the caller's array.
+struct InstanceKey
+{
+  unsigned long long key;
+  size_t index;
+};
+
+// (x, y) as a sort key, rows first.  it's relative to the clip, and held to the clip's edges, so
+// nothing wraps around however far outside the clip it is.
+inline unsigned long long GetPositionKey(long x, long y, const ClipRect& clip)
+{
+  x = x < clip.left ? clip.left : (x > clip.right ? clip.right : x);
+  y = y < clip.top ? clip.top : (y > clip.bottom ? clip.bottom : y);
+  return (static_cast<unsigned long long>(static_cast<DWORD>(y - clip.top)) << 32) | static_cast<DWORD>(x - clip.left);
+}
+
+// LSD radix sort, a byte at a time.  bytes that are the same in every key (most of them, for
+// sizes and positions) are skipped, and it's stable, so ties stay in the order they came in.  the
+// scratch comes from the same place as the keys.
+inline void SortInstanceKeys(FrameVector<InstanceKey>& keys)
+{
+  size_t n = keys.size();
+  if(n < 2)
+  {
+    return;
+  }
+
+  FrameVector<size_t> counts(8 * 256, 0, keys.get_allocator());
+  size_t i;
+  long b;
+  for(i = 0; i < n; i ++)
+  {
+    for(b = 0; b < 8; b ++)
+    {
+      counts[(b * 256) + ((keys[i].key >> (b * 8)) & 0xff)] ++;
+    }
+  }
+
+  FrameVector<InstanceKey> temp(n, InstanceKey(), keys.get_allocator());
+  for(b = 0; b < 8; b ++)
+  {
+    size_t* pCounts = &counts[b * 256];
+    long shift = b * 8;
+    if(pCounts[(keys[0].key >> shift) & 0xff] == n)
+    {
+      continue;
+    }
+
+    size_t total = 0;
+    for(long d = 0; d < 256; d ++)
+    {
+      size_t c = pCounts[d];
+      pCounts[d] = total;
+      total += c;
+    }
+    for(i = 0; i < n; i ++)
+    {
+      temp[pCounts[(keys[i].key >> shift) & 0xff] ++] = keys[i];
+    }
+    keys.swap(temp);
+  }
+}
+
+// what's different about the two kinds of instance: how far out they go, and what makes two of
+// them the same size (same key, same tables).
+inline long GetInstanceRadius(const CircleInstance& c)
+{
+  return c.r;
+}
+
+inline unsigned long long GetInstanceSizeKey(const CircleInstance& c)
+{
+  return static_cast<DWORD>(c.r);
+}
+
+inline long GetInstanceRadius(const DonutInstance& d)
+{
+  return d.rin + d.width;
+}
+
+inline unsigned long long GetInstanceSizeKey(const DonutInstance& d)
+{
+  return (static_cast<unsigned long long>(static_cast<DWORD>(d.rin)) << 32) | static_cast<DWORD>(d.width);
+}
+
+/*
+  The instances that can touch the clip, in drawing order.  groups[i] is the size group of
+  instance i (only set for the ones in "order"), and firsts[g] is some instance in group g, to
+  build that group's tables from.
+*/
+template<typename Tinstance>
+void SortInstances(const Tinstance* begin, size_t n, const ClipRect& clip, FrameVector<InstanceKey>& order, FrameVector<size_t>& groups, FrameVector<size_t>& firsts)
+{
+  size_t i;
+  order.clear();
+  order.reserve(n);
+  groups.resize(n);
+  firsts.clear();
+
+  for(i = 0; i < n; i ++)
+  {
+    const Tinstance& s = begin[i];
+    long r = GetInstanceRadius(s);
+    // the AA pixels go one past the spans on every side
+    if(IsBoxVisible(clip, s.cx - r - 1, s.cy - r - 1, s.cx + r, s.cy + r))
+    {
+      InstanceKey k;
+      k.key = GetInstanceSizeKey(s);
+      k.index = i;
+      order.push_back(k);
+    }
+  }
+
+  // by size first, to number the groups
+  SortInstanceKeys(order);
+  for(i = 0; i < order.size(); i ++)
+  {
+    if(i == 0 || order[i].key != order[i - 1].key)
+    {
+      firsts.push_back(order[i].index);
+    }
+    groups[order[i].index] = firsts.size() - 1;
+  }
+
+  // then by center.  the ones centered outside the clip sort as if they were on its edge.
+  for(i = 0; i < order.size(); i ++)
+  {
+    const Tinstance& s = begin[order[i].index];
+    order[i].key = GetPositionKey(s.cx, s.cy, clip);
+  }
+  SortInstanceKeys(order);
+}
+
+
+template<typename Tsink>
+void DrawCircles(const CircleInstance* begin, size_t n, const ClipRect& clip, Tsink& sink, FrameArena* pArena = 0)
+{
+  GEOM_ZONE("DrawCircles");
+  FrameArena::Scope scope(pArena);
+  FrameVector<InstanceKey> order(pArena);
+  FrameVector<size_t> groups(pArena);
+  FrameVector<size_t> firsts(pArena);
+  SortInstances(begin, n, clip, order, groups, firsts);
+
+  std::vector<std::shared_ptr<const CircleHeights> > tables(firsts.size());
+  for(size_t g = 0; g < firsts.size(); g ++)
+  {
+    tables[g] = GetCircleTable<CircleHeights>(begin[firsts[g]].r);
+  }
+
+  for(size_t i = 0; i < order.size(); i ++)
+  {
+    const CircleInstance& c = begin[order[i].index];
+    FilledCircleRows(*tables[groups[order[i].index]], c.cx, c.cy, clip, sink);
+  }
+}
+
+template<typename Tsink>
+void DrawCircles(const CircleInstance* begin, size_t n, Tsink& sink)
+{
+  DrawCircles(begin, n, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void DrawCirclesAA(const CircleInstance* begin, size_t n, const ClipRect& clip, Tsink& sink, FrameArena* pArena = 0)
+{
+  GEOM_ZONE("DrawCirclesAA");
+  FrameArena::Scope scope(pArena);
+  FrameVector<InstanceKey> order(pArena);
+  FrameVector<size_t> groups(pArena);
+  FrameVector<size_t> firsts(pArena);
+  SortInstances(begin, n, clip, order, groups, firsts);
+
+  FrameVector<CircleRowList> rows(firsts.size(), CircleRowList(pArena), pArena);
+  for(size_t g = 0; g < firsts.size(); g ++)
+  {
+    std::shared_ptr<const CircleHeightsAA<false> > pHeights = GetCircleTable<CircleHeightsAA<false> >(begin[firsts[g]].r);
+    rows[g].Init(*pHeights, 0);
+  }
+
+  for(size_t i = 0; i < order.size(); i ++)
+  {
+    const CircleInstance& c = begin[order[i].index];
+    CircleRows(rows[groups[order[i].index]], c.cx, c.cy, clip, sink);
+  }
+}
+
+template<typename Tsink>
+void DrawCirclesAA(const CircleInstance* begin, size_t n, Tsink& sink)
+{
+  DrawCirclesAA(begin, n, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void DrawDonuts(const DonutInstance* begin, size_t n, const ClipRect& clip, Tsink& sink, FrameArena* pArena = 0)
+{
+  GEOM_ZONE("DrawDonuts");
+  FrameArena::Scope scope(pArena);
+  FrameVector<InstanceKey> order(pArena);
+  FrameVector<size_t> groups(pArena);
+  FrameVector<size_t> firsts(pArena);
+  SortInstances(begin, n, clip, order, groups, firsts);
+
+  std::vector<std::shared_ptr<const CircleHeights> > outers(firsts.size());
+  std::vector<std::shared_ptr<const CircleHeights> > inners(firsts.size());
+  for(size_t g = 0; g < firsts.size(); g ++)
+  {
+    const DonutInstance& d = begin[firsts[g]];
+    outers[g] = GetCircleTable<CircleHeights>(d.rin + d.width);
+    inners[g] = GetCircleTable<CircleHeights>(d.rin);
+  }
+
+  for(size_t i = 0; i < order.size(); i ++)
+  {
+    const DonutInstance& d = begin[order[i].index];
+    size_t g = groups[order[i].index];
+    DonutRows(*outers[g], *inners[g], d.cx, d.cy, clip, sink);
+  }
+}
+
+template<typename Tsink>
+void DrawDonuts(const DonutInstance* begin, size_t n, Tsink& sink)
+{
+  DrawDonuts(begin, n, ClipRect::Everything(), sink);
+}
+
+
+template<typename Tsink>
+void DrawDonutsAA(const DonutInstance* begin, size_t n, const ClipRect& clip, Tsink& sink, FrameArena* pArena = 0)
+{
+  GEOM_ZONE("DrawDonutsAA");
+  FrameArena::Scope scope(pArena);
+  FrameVector<InstanceKey> order(pArena);
+  FrameVector<size_t> groups(pArena);
+  FrameVector<size_t> firsts(pArena);
+  SortInstances(begin, n, clip, order, groups, firsts);
+
+  FrameVector<CircleRowList> rows(firsts.size(), CircleRowList(pArena), pArena);
+  for(size_t g = 0; g < firsts.size(); g ++)
+  {
+    const DonutInstance& d = begin[firsts[g]];
+    std::shared_ptr<const CircleHeightsAA<false> > pOuter = GetCircleTable<CircleHeightsAA<false> >(d.rin + d.width);
+    std::shared_ptr<const CircleHeightsAA<true> > pInner = GetCircleTable<CircleHeightsAA<true> >(d.rin);
+    rows[g].Init(*pOuter, pInner.get());
+  }
+
+  for(size_t i = 0; i < order.size(); i ++)
+  {
+    const DonutInstance& d = begin[order[i].index];
+    CircleRows(rows[groups[order[i].index]], d.cx, d.cy, clip, sink);
+  }
+}
+
+template<typename Tsink>
+void DrawDonutsAA(const DonutInstance* begin, size_t n, Tsink& sink)
+{
+  DrawDonutsAA(begin, n, ClipRect::Everything(), sink);
+}
+
+
+/*
+  ScanlineRenderer draws a whole list of circles, donuts and rectangles in one sweep down the
+  screen.  Drawing them one at a time (or even as a batch, above) goes through each shape's rows
+  on its own, so a framebuffer row where many shapes overlap gets pulled into the cache once per
+  shape.  Here y goes from top to bottom once; at each row, every shape that's on it (the
+  "active list") puts out its part of that row before moving on to the next one.
+
+    ScanlineRenderer scene;
+    scene.AddCircleAA(100, 100, 40);
+    scene.AddDonut(300, 120, 20, 10);
+    scene.AddRect(0, 0, 640, 8);
+    scene.Draw(clip, sink);
+
+  Round shapes draw the same pixels as their *Rows() versions (for AA, the single pass ones), and
+  rects fill left..right-1 by top..bottom-1 like a RECT.  Each size of round shape gets its rows
+  worked out once per scene, however many shapes use it.  Within a row, the shapes go in order
+  of their top row, then left edge.
+
+  The sink gets everything in row order, so it can be anything that takes AddSpan() /
+  AddCoverage() (see spanbuffer.h).  Draw() can be called as often as you like; the shapes stay
+  until Clear().
+*/
+class ScanlineRenderer
+{
+public:
+  void Clear()
+  {
+    m_shapes.clear();
+    m_lists.clear();
+    m_listKeys.clear();
+  }
+
+  void AddCircle(long cx, long cy, long r)
+  {
+    AddRound(cx, cy, r, -1, false);
+  }
+
+  void AddCircleAA(long cx, long cy, long r)
+  {
+    AddRound(cx, cy, r, -1, true);
+  }
+
+  void AddDonut(long cx, long cy, long rin, long width)
+  {
+    AddRound(cx, cy, rin + width, rin, false);
+  }
+
+  void AddDonutAA(long cx, long cy, long rin, long width)
+  {
+    AddRound(cx, cy, rin + width, rin, true);
+  }
+
+  void AddRect(long left, long top, long right, long bottom)
+  {
+    if(left < right && top < bottom)
+    {
+      Shape s;
+      s.top = top;
+      s.bottom = bottom;
+      s.left = left;
+      s.right = right;
+      s.cx = 0;
+      s.cy = 0;
+      s.list = NoList;
+      m_shapes.push_back(s);
+    }
+  }
+
+  long GetShapeCount() const
+  {
+    return static_cast<long>(m_shapes.size());
+  }
+
+  // pArena (see framearena.h) is for the sort and the active list; 0 means the heap.
+  template<typename Tsink>
+  void Draw(const ClipRect& clip, Tsink& sink, FrameArena* pArena = 0) const
+  {
+    GEOM_ZONE("ScanlineRenderer::Draw");
+    FrameArena::Scope scope(pArena);
+    FrameVector<InstanceKey> order(pArena);
+    order.reserve(m_shapes.size());
+    for(size_t i = 0; i < m_shapes.size(); i ++)
+    {
+      const Shape& s = m_shapes[i];
+      if(IsBoxVisible(clip, s.left, s.top, s.right - 1, s.bottom - 1))
+      {
+        // by where they come into the clip, which is the order the sweep picks them up in
+        InstanceKey k;
+        k.key = GetPositionKey(s.left, s.top, clip);
+        k.index = i;
+        order.push_back(k);
+      }
+    }
+    SortInstanceKeys(order);
+
+    FrameVector<size_t> active(pArena);
+    size_t next = 0;
+    long y = clip.top;
+    size_t i;
+    size_t n;
+    while(y < clip.bottom && (next < order.size() || !active.empty()))
+    {
+      // nothing on this row; skip down to the next shape
+      if(active.empty() && m_shapes[order[next].index].top > y)
+      {
+        y = m_shapes[order[next].index].top;
+        if(y >= clip.bottom)
+        {
+          break;
+        }
+      }
+
+      while(next < order.size() && m_shapes[order[next].index].top <= y)
+      {
+        active.push_back(order[next].index);
+        next ++;
+      }
+
+      // draw everybody's part of the row, dropping the ones that are done
+      n = 0;
+      for(i = 0; i < active.size(); i ++)
+      {
+        const Shape& s = m_shapes[active[i]];
+        if(s.bottom <= y)
+        {
+          continue;
+        }
+        active[n ++] = active[i];
+
+        if(s.list == NoList)
+        {
+          AddClippedSpan(sink, clip, s.left, s.right - 1, y);
+        }
+        else
+        {
+          const CircleRowList& rows = m_lists[s.list];
+          long q = y >= s.cy ? y - s.cy : s.cy - y - 1;
+          AddCircleRow(rows, rows.GetRow(q), s.cx, y, clip, sink);
+        }
+      }
+      active.resize(n);
+      y ++;
+    }
+  }
+
+  template<typename Tsink>
+  void Draw(Tsink& sink) const
+  {
+    Draw(ClipRect::Everything(), sink);
+  }
+
+private:
+  static const size_t NoList = ~static_cast<size_t>(0);
+
+  // rows are top..bottom-1 and x's are left..right-1, for culling and sorting.  round shapes use
+  // m_lists[list] around (cx, cy); rects have list == NoList.
+  struct Shape
+  {
+    long top;
+    long bottom;
+    long left;
+    long right;
+    long cx;
+    long cy;
+    size_t list;
+  };
+
+  // which CircleRowList a round shape uses.  rin is -1 for no hole.
+  struct ListKey
+  {
+    long rout;
+    long rin;
+    bool bAA;
+
+    bool operator<(const ListKey& rhs) const
+    {
+      if(rout != rhs.rout) return rout < rhs.rout;
+      if(rin != rhs.rin) return rin < rhs.rin;
+      return bAA < rhs.bAA;
+    }
+  };
+
+  size_t GetList(long rout, long rin, bool bAA)
+  {
+    ListKey key = { rout, rin, bAA };
+    std::map<ListKey, size_t>::const_iterator it = m_listKeys.find(key);
+    if(it != m_listKeys.end())
+    {
+      return it->second;
+    }
+
+    size_t list = m_lists.size();
+    m_lists.push_back(CircleRowList());
+    if(bAA)
+    {
+      std::shared_ptr<const CircleHeightsAA<false> > pOuter = GetCircleTable<CircleHeightsAA<false> >(rout);
+      std::shared_ptr<const CircleHeightsAA<true> > pInner;
+      if(rin >= 0)
+      {
+        pInner = GetCircleTable<CircleHeightsAA<true> >(rin);
+      }
+      m_lists[list].Init(*pOuter, pInner.get());
+    }
+    else
+    {
+      std::shared_ptr<const CircleHeights> pOuter = GetCircleTable<CircleHeights>(rout);
+      std::shared_ptr<const CircleHeights> pInner;
+      if(rin >= 0)
+      {
+        pInner = GetCircleTable<CircleHeights>(rin);
+      }
+      m_lists[list].Init(*pOuter, pInner.get());
+    }
+    m_listKeys[key] = list;
+    return list;
+  }
+
+  void AddRound(long cx, long cy, long rout, long rin, bool bAA)
+  {
+    size_t list = GetList(rout, rin, bAA);
+    long nRows = m_lists[list].GetRowCount();
+    if(nRows > 0)
+    {
+      Shape s;
+      s.top = cy - nRows;
+      s.bottom = cy + nRows;
+      // no row reaches out further than there are rows
+      s.left = cx - nRows;
+      s.right = cx + nRows;
+      s.cx = cx;
+      s.cy = cy;
+      s.list = list;
+      m_shapes.push_back(s);
+    }
+  }
+
+  std::vector<Shape> m_shapes;
+  std::vector<CircleRowList> m_lists;
+  std::map<ListKey, size_t> m_listKeys;
+};
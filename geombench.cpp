@@ -0,0 +1,468 @@
+/*
+  Headless benchmark for the geom.h rasterizers.  Runs the same tests as the interactive test app
+  (see geomtests.h) into a SoftBitmap for a fixed number of frames over a resolution / radius
+  sweep, and writes the results as JSON so they can be diffed between builds.
+
+  build:
+    g++ -O2 -std=c++14 -pthread -o geombench geombench.cpp
+    cl /O2 /EHsc /std:c++14 geombench.cpp
+
+  C++14 matters: below that GEOM_STATIC_CIRCLE_TABLES is off (see circletables.h) and every
+  circle table comes from the Init() loops instead.
+
+  usage:
+    geombench [--frames N] [--warmup N] [--res WxH]... [--radius R]... [--test NAME]... [--simd LEVEL] [--dirty] [--buffers N] [--out FILE] [--trace FILE]
+
+    --res and --radius can be repeated; each test runs for every combination that fits.  A
+    radius of 0 means "fit", which is what the test app draws: circles get (min(w,h)/2-3)/3 and
+    donuts go from there out to min(w,h)/2-3.  Other radii are used for circles and as the outer
+    radius of donuts, with the hole at 1/3 of that.  Ellipses use the same rin / rout as the donuts
+    (see DrawGeomTest()), and the circle grid tests size their circles off the radius.  TID_Fill
+    ignores the radius.
+
+    NAME is the test ID name with or without the TID_ prefix (Fill, FilledCircleG, ...).
+
+    LEVEL caps the pixel kernels (see pixelkernels.h): scalar, sse2, avx2 or avx512.  The
+    default is the best the machine supports.
+
+    --dirty turns on the bitmap's dirty tracking, so the clear only erases what the last frame
+    drew (see PixelBuffer::ClearDirty()), like the test app does.  The output is the same.
+
+    --buffers N (1-3) renders through a SwapChain with N buffers, and a consumer thread that
+    checksums every frame the way an encoder would read it.  1 is the serial case; 2 and 3 let
+    the next frame render while the last one is consumed.  The default, 0, has no consumer.
+
+    --trace FILE writes a Chrome trace (chrome://tracing, ui.perfetto.dev) of the whole run, with
+    the rasterizer zones and the per-frame pixel / span / table counters (see profile.h).  Only
+    in a build with -DGEOM_PROFILE=1; it costs enough that the timings are off.
+
+  every frame includes the clear, just like in the test app.  "pixels_per_frame" counts the clear
+  plus every pixel the callbacks touched, and mpixels_per_sec is based on that.  render_ns and
+  latency_ns are the swap chain's averages (see swapchain.h).  "checksum" is a
+  hash of the last frame, so a change in it means the output changed.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "softbitmap.h"
+#include "geomtests.h"
+#include "swapchain.h"
+
+
+struct BenchResult
+{
+  long TestID;
+  long width;
+  long height;
+  long radius;
+  long rin;
+  long rout;
+  long frames;
+  double nsPerFrame;
+  double p50;
+  double p99;
+  double nsMin;
+  double nsMax;
+  double renderNs;
+  double latencyNs;
+  long long pixelsPerFrame;
+  double mpixelsPerSec;
+  DWORD checksum;
+};
+
+
+// FNV-1a over the visible pixels
+inline DWORD ChecksumBitmap(const SoftBitmap& bmp)
+{
+  DWORD h = 2166136261u;
+  for(long y = 0; y < bmp.GetHeight(); y ++)
+  {
+    const RgbPixel* p = bmp.GetRow(y);
+    for(long x = 0; x < bmp.GetWidth(); x ++)
+    {
+      h = (h ^ p[x]) * 16777619u;
+    }
+  }
+  return h;
+}
+
+
+inline double Percentile(const std::vector<double>& sorted, double pct)
+{
+  size_t i = static_cast<size_t>((pct / 100.0) * (sorted.size() - 1) + 0.5);
+  return sorted[i];
+}
+
+
+// stands in for an encoder: reads every pixel of every frame, on the swap chain's thread.
+struct ChecksumConsumer
+{
+  DWORD checksum;
+
+  void operator()(SoftBitmap& bmp)
+  {
+    checksum = ChecksumBitmap(bmp);
+  }
+};
+
+
+BenchResult RunBench(long TestID, long w, long h, long radius, long rin, long rout, long frames, long warmup, bool bDirty, long nBuffers)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  // with no consumer the chain just hands the one buffer right back
+  SwapChain<SoftBitmap> chain(nBuffers > 0 ? nBuffers : 1);
+  GeomTest<SoftBitmap>* tests[SwapChain<SoftBitmap>::MaxBuffers];
+  ChecksumConsumer consumer = { 0 };
+  chain.SetSize(w, h);
+  for(long i = 0; i < chain.GetBufferCount(); i ++)
+  {
+    chain.GetBuffer(i).SetDirtyTracking(bDirty);
+    tests[i] = new GeomTest<SoftBitmap>(chain.GetBuffer(i));
+  }
+  if(nBuffers > 0)
+  {
+    chain.Start(consumer);
+  }
+
+  std::vector<double> times;
+  times.reserve(frames);
+  double render = 0;
+  double latency = 0;
+  long last = 0;
+
+  for(long i = 0; i < warmup; i ++)
+  {
+    SoftBitmap& bmp = chain.BeginFrame();
+    DrawGeomTest(TestID, bmp, *tests[chain.GetBackBufferIndex()], w / 2, h / 2, radius, rin, rout);
+    chain.EndFrame();
+    GEOM_PROFILE_FRAME(static_cast<long long>(w) * h);
+  }
+
+  for(long i = 0; i < chain.GetBufferCount(); i ++)
+  {
+    tests[i]->ResetPixelCount();
+  }
+  Clock::time_point start = Clock::now();
+  for(long i = 0; i < frames; i ++)
+  {
+    Clock::time_point f0 = Clock::now();
+    SoftBitmap& bmp = chain.BeginFrame();
+    last = chain.GetBackBufferIndex();
+    DrawGeomTest(TestID, bmp, *tests[last], w / 2, h / 2, radius, rin, rout);
+    chain.EndFrame();
+    GEOM_PROFILE_FRAME(static_cast<long long>(w) * h);
+    Clock::time_point f1 = Clock::now();
+    times.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(f1 - f0).count()));
+    render += chain.GetRenderTime();
+    latency += chain.GetLatency();
+  }
+  chain.Stop();
+  double total = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+  std::sort(times.begin(), times.end());
+
+  long long pixels = 0;
+  for(long i = 0; i < chain.GetBufferCount(); i ++)
+  {
+    pixels += tests[i]->GetPixelCount();
+    delete tests[i];
+  }
+
+  BenchResult r;
+  r.TestID = TestID;
+  r.width = w;
+  r.height = h;
+  r.radius = radius;
+  r.rin = rin;
+  r.rout = rout;
+  r.frames = frames;
+  r.nsPerFrame = total / frames;
+  r.p50 = Percentile(times, 50);
+  r.p99 = Percentile(times, 99);
+  r.nsMin = times.front();
+  r.nsMax = times.back();
+  r.renderNs = (render * 1e9) / frames;
+  r.latencyNs = (latency * 1e9) / frames;
+  // a dirty clear counts its own pixels
+  r.pixelsPerFrame = (pixels / frames) + (bDirty ? 0 : static_cast<long long>(w) * h);
+  r.mpixelsPerSec = (static_cast<double>(r.pixelsPerFrame) * 1000.0) / r.nsPerFrame;
+  r.checksum = (nBuffers > 0) ? consumer.checksum : ChecksumBitmap(chain.GetBuffer(last));
+  return r;
+}
+
+
+void WriteJSON(FILE* f, const std::vector<BenchResult>& results, long frames, long warmup, bool bDirty, long nBuffers)
+{
+  fprintf(f, "{\n");
+  fprintf(f, "  \"benchmark\": \"geombench\",\n");
+  fprintf(f, "  \"frames\": %ld,\n", frames);
+  fprintf(f, "  \"warmup\": %ld,\n", warmup);
+  fprintf(f, "  \"simd\": \"%s\",\n", GetPixelKernelName(GetPixelKernelLevel()));
+  fprintf(f, "  \"dirty\": %s,\n", bDirty ? "true" : "false");
+  fprintf(f, "  \"buffers\": %ld,\n", nBuffers);
+  fprintf(f, "  \"results\": [\n");
+  for(size_t i = 0; i < results.size(); i ++)
+  {
+    const BenchResult& r = results[i];
+    fprintf(f, "    {\"test\": \"%s\", \"width\": %ld, \"height\": %ld, \"radius\": %ld, \"rin\": %ld, \"rout\": %ld, "
+      "\"frames\": %ld, \"ns_per_frame\": %.1f, \"p50_ns\": %.1f, \"p99_ns\": %.1f, \"min_ns\": %.1f, \"max_ns\": %.1f, "
+      "\"render_ns\": %.1f, \"latency_ns\": %.1f, "
+      "\"pixels_per_frame\": %lld, \"mpixels_per_sec\": %.2f, \"checksum\": \"%08x\"}%s\n",
+      GetGeomTestName(r.TestID), r.width, r.height, r.radius, r.rin, r.rout,
+      r.frames, r.nsPerFrame, r.p50, r.p99, r.nsMin, r.nsMax,
+      r.renderNs, r.latencyNs,
+      r.pixelsPerFrame, r.mpixelsPerSec, static_cast<unsigned int>(r.checksum),
+      (i + 1 < results.size()) ? "," : "");
+  }
+  fprintf(f, "  ]\n");
+  fprintf(f, "}\n");
+}
+
+
+long ParseTestName(const char* s)
+{
+  static const long ids[] = { TID_Fill, TID_FilledCircleG, TID_FilledCircleAAG, TID_DonutG, TID_DonutAAG, TID_DonutAABands,
+    TID_FilledEllipseG, TID_FilledEllipseAAG, TID_EllipseRingG, TID_DonutAAGClipped,
+    TID_LineG, TID_LineAAG, TID_ThickLineAAG, TID_FilledCircleAARows, TID_DonutAARows,
+    TID_CircleGridAAG, TID_DrawCirclesAA, TID_ScanlineCirclesAA,
+    TID_MaskCompositeAA, TID_StampCirclesAA };
+  for(size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i ++)
+  {
+    const char* name = GetGeomTestName(ids[i]);
+    if(!strcmp(s, name) || !strcmp(s, name + 4))
+    {
+      return ids[i];
+    }
+  }
+  return -1;
+}
+
+
+int Usage()
+{
+  fprintf(stderr, "usage: geombench [--frames N] [--warmup N] [--res WxH]... [--radius R]... [--test NAME]... [--simd LEVEL] [--dirty] [--buffers N] [--out FILE] [--trace FILE]\n");
+  return 1;
+}
+
+
+int main(int argc, char** argv)
+{
+  long frames = 200;
+  long warmup = 10;
+  std::vector<long> tests;
+  std::vector<long> widths;
+  std::vector<long> heights;
+  std::vector<long> radii;
+  const char* outfile = 0;
+#if GEOM_PROFILE
+  const char* tracefile = 0;
+#endif
+  bool bDirty = false;
+  long nBuffers = 0;
+
+  for(int i = 1; i < argc; i ++)
+  {
+    const char* arg = argv[i];
+    const char* val = (i + 1 < argc) ? argv[i + 1] : 0;
+    if(!strcmp(arg, "--dirty"))
+    {
+      bDirty = true;
+      continue;
+    }
+    if(!val)
+    {
+      return Usage();
+    }
+    i ++;
+
+    if(!strcmp(arg, "--frames"))
+    {
+      frames = atol(val);
+    }
+    else if(!strcmp(arg, "--warmup"))
+    {
+      warmup = atol(val);
+    }
+    else if(!strcmp(arg, "--res"))
+    {
+      long w = 0, h = 0;
+      if(sscanf(val, "%ldx%ld", &w, &h) != 2 || w < 1 || h < 1)
+      {
+        return Usage();
+      }
+      widths.push_back(w);
+      heights.push_back(h);
+    }
+    else if(!strcmp(arg, "--radius"))
+    {
+      radii.push_back(atol(val));
+    }
+    else if(!strcmp(arg, "--test"))
+    {
+      long id = ParseTestName(val);
+      if(id < 0)
+      {
+        fprintf(stderr, "unknown test %s\n", val);
+        return 1;
+      }
+      tests.push_back(id);
+    }
+    else if(!strcmp(arg, "--simd"))
+    {
+      long level = PK_AVX512;
+      while(level >= PK_Scalar && strcmp(val, GetPixelKernelName(level)))
+      {
+        level --;
+      }
+      if(level < PK_Scalar)
+      {
+        return Usage();
+      }
+      SetPixelKernelLevel(level);
+    }
+    else if(!strcmp(arg, "--buffers"))
+    {
+      nBuffers = atol(val);
+      if(nBuffers < 0 || nBuffers > SwapChain<SoftBitmap>::MaxBuffers)
+      {
+        return Usage();
+      }
+    }
+    else if(!strcmp(arg, "--out"))
+    {
+      outfile = val;
+    }
+    else if(!strcmp(arg, "--trace"))
+    {
+#if GEOM_PROFILE
+      tracefile = val;
+#else
+      fprintf(stderr, "--trace needs a build with GEOM_PROFILE=1\n");
+      return 1;
+#endif
+    }
+    else
+    {
+      return Usage();
+    }
+  }
+
+  if(frames < 1)
+  {
+    return Usage();
+  }
+
+  if(tests.empty())
+  {
+    tests.push_back(TID_Fill);
+    tests.push_back(TID_FilledCircleG);
+    tests.push_back(TID_FilledCircleAAG);
+    tests.push_back(TID_DonutG);
+    tests.push_back(TID_DonutAAG);
+    tests.push_back(TID_DonutAABands);
+    tests.push_back(TID_FilledEllipseG);
+    tests.push_back(TID_FilledEllipseAAG);
+    tests.push_back(TID_EllipseRingG);
+    tests.push_back(TID_DonutAAGClipped);
+    tests.push_back(TID_LineG);
+    tests.push_back(TID_LineAAG);
+    tests.push_back(TID_ThickLineAAG);
+    tests.push_back(TID_FilledCircleAARows);
+    tests.push_back(TID_DonutAARows);
+    tests.push_back(TID_CircleGridAAG);
+    tests.push_back(TID_DrawCirclesAA);
+    tests.push_back(TID_ScanlineCirclesAA);
+    tests.push_back(TID_MaskCompositeAA);
+    tests.push_back(TID_StampCirclesAA);
+  }
+  if(widths.empty())
+  {
+    widths.push_back(640); heights.push_back(480);
+    widths.push_back(1920); heights.push_back(1080);
+    widths.push_back(3840); heights.push_back(2160);
+  }
+  if(radii.empty())
+  {
+    radii.push_back(8);
+    radii.push_back(64);
+    radii.push_back(0);
+  }
+
+  std::vector<BenchResult> results;
+  for(size_t t = 0; t < tests.size(); t ++)
+  {
+    for(size_t s = 0; s < widths.size(); s ++)
+    {
+      long w = widths[s];
+      long h = heights[s];
+      long fit = ((w < h ? w : h) / 2) - 3;
+
+      if(tests[t] == TID_Fill)
+      {
+        // the radius means nothing to a fill, so only do it once per resolution.
+        fprintf(stderr, "%s %ldx%ld...\n", GetGeomTestName(tests[t]), w, h);
+        results.push_back(RunBench(tests[t], w, h, 0, 0, 0, frames, warmup, bDirty, nBuffers));
+        continue;
+      }
+
+      for(size_t ri = 0; ri < radii.size(); ri ++)
+      {
+        long radius, rin, rout;
+        if(radii[ri] > 0)
+        {
+          rout = radii[ri];
+          rin = rout / 3;
+          radius = rout;
+        }
+        else
+        {
+          rout = fit;
+          rin = rout / 3;
+          radius = rin;
+        }
+
+        if(rout > fit || rin < 1)
+        {
+          continue;
+        }
+
+        fprintf(stderr, "%s %ldx%ld r=%ld...\n", GetGeomTestName(tests[t]), w, h, radius);
+        results.push_back(RunBench(tests[t], w, h, radius, rin, rout, frames, warmup, bDirty, nBuffers));
+      }
+    }
+  }
+
+  FILE* f = stdout;
+  if(outfile)
+  {
+    f = fopen(outfile, "w");
+    if(!f)
+    {
+      fprintf(stderr, "can't open %s\n", outfile);
+      return 1;
+    }
+  }
+  WriteJSON(f, results, frames, warmup, bDirty, nBuffers);
+  if(f != stdout)
+  {
+    fclose(f);
+  }
+
+#if GEOM_PROFILE
+  if(tracefile && !Profiler::WriteChromeTrace(tracefile))
+  {
+    fprintf(stderr, "can't write %s\n", tracefile);
+    return 1;
+  }
+#endif
+
+  return 0;
+}
+
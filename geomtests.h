@@ -0,0 +1,425 @@
+/*
+  The drawing tests, shared by the interactive test app ("0714 geom performance.cpp") and the
+  headless benchmark (geombench.cpp) so both are measuring exactly the same thing.
+
+  Tbmp is AnimBitmap or SoftBitmap (anything with the PixelBuffer API).  The GDI / GDI+ tests
+  obviously need a DC, so they stay in the test app.
+*/
+
+
+#pragma once
+
+
+#include <atomic>
+#include <vector>
+#include <math.h>
+#include "pixelbuffer.h"
+#include "coveragemask.h"
+#include "stampcache.h"
+#include "geom.h"
+
+
+const long TID_Fill = 0;
+const long TID_GDICircle = 1;
+const long TID_GDIPlusCircle = 2;
+const long TID_FilledCircleG = 3;
+const long TID_FilledCircleAAG = 5;
+const long TID_DonutG = 7;
+const long TID_DonutAAG = 8;
+const long TID_DonutAABands = 9;
+const long TID_FilledEllipseG = 10;
+const long TID_FilledEllipseAAG = 11;
+const long TID_EllipseRingG = 12;
+const long TID_DonutAAGClipped = 13;
+const long TID_LineG = 14;
+const long TID_LineAAG = 15;
+const long TID_ThickLineAAG = 16;
+const long TID_FilledCircleAARows = 17;
+const long TID_DonutAARows = 18;
+const long TID_CircleGridAAG = 19;
+const long TID_DrawCirclesAA = 20;
+const long TID_ScanlineCirclesAA = 21;
+const long TID_MaskCompositeAA = 22;
+const long TID_StampCirclesAA = 23;
+
+
+inline const char* GetGeomTestName(long TestID)
+{
+  switch(TestID)
+  {
+  case TID_Fill: return "TID_Fill";
+  case TID_GDICircle: return "TID_GDICircle";
+  case TID_GDIPlusCircle: return "TID_GDIPlusCircle";
+  case TID_FilledCircleG: return "TID_FilledCircleG";
+  case TID_FilledCircleAAG: return "TID_FilledCircleAAG";
+  case TID_DonutG: return "TID_DonutG";
+  case TID_DonutAAG: return "TID_DonutAAG";
+  case TID_DonutAABands: return "TID_DonutAABands";
+  case TID_FilledEllipseG: return "TID_FilledEllipseG";
+  case TID_FilledEllipseAAG: return "TID_FilledEllipseAAG";
+  case TID_EllipseRingG: return "TID_EllipseRingG";
+  case TID_DonutAAGClipped: return "TID_DonutAAGClipped";
+  case TID_LineG: return "TID_LineG";
+  case TID_LineAAG: return "TID_LineAAG";
+  case TID_ThickLineAAG: return "TID_ThickLineAAG";
+  case TID_FilledCircleAARows: return "TID_FilledCircleAARows";
+  case TID_DonutAARows: return "TID_DonutAARows";
+  case TID_CircleGridAAG: return "TID_CircleGridAAG";
+  case TID_DrawCirclesAA: return "TID_DrawCirclesAA";
+  case TID_ScanlineCirclesAA: return "TID_ScanlineCirclesAA";
+  case TID_MaskCompositeAA: return "TID_MaskCompositeAA";
+  case TID_StampCirclesAA: return "TID_StampCirclesAA";
+  }
+  return "?";
+}
+
+
+// the old tests mixed 2/10 of the color in with MixColorsInt(2, 10, ...).  same thing in 0-255.
+const BYTE GeomTestAlpha = 51;
+
+
+// the callbacks the *G functions draw through.
+template<typename Tbmp>
+class GeomTest
+{
+public:
+  GeomTest(Tbmp& bmp) :
+    m_bmp(bmp),
+    m_pixels(0)
+  {
+  }
+
+  void DonutAA2_SetAlphaPixel(long cx, long cy, long x, long y, long f, long fmax)
+  {
+    //m_bmp.SetPixel(cx+x, cy+y, MixColorsInt(f, fmax, MakeRgbPixel(255,255,255), m_bmp.GetPixel(cx+x, cy+y)));
+    //m_bmp.SetPixel(cx+x, cy-y-1, MixColorsInt(f, fmax, MakeRgbPixel(255,255,255), m_bmp.GetPixel(cx+x, cy-y-1)));
+    //m_bmp.SetPixel(cx-x-1, cy+y, MixColorsInt(f, fmax, MakeRgbPixel(255,255,255), m_bmp.GetPixel(cx-x-1, cy+y)));
+    //m_bmp.SetPixel(cx-x-1, cy-y-1, MixColorsInt(f, fmax, MakeRgbPixel(255,255,255), m_bmp.GetPixel(cx-x-1, cy-y-1)));
+    m_bmp.BlendPixel(cx+x, cy+y, MakeRgbPixel(255,0,0), GeomTestAlpha);
+    m_bmp.BlendPixel(cx+x, cy-y-1, MakeRgbPixel(255,0,0), GeomTestAlpha);
+    m_bmp.BlendPixel(cx-x-1, cy+y, MakeRgbPixel(255,0,0), GeomTestAlpha);
+    m_bmp.BlendPixel(cx-x-1, cy-y-1, MakeRgbPixel(255,0,0), GeomTestAlpha);
+    m_pixels += 4;
+  }
+
+  // the AA callback for the clipped *G functions, which hand over one real pixel at a time.  the
+  // coverage scales the alpha, so it ends up in the checksum.
+  void SetAlphaPixel(long x, long y, long f, long fmax)
+  {
+    m_bmp.BlendPixel(x, y, MakeRgbPixel(255,0,0), static_cast<BYTE>((GeomTestAlpha * f) / fmax));
+    m_pixels ++;
+  }
+
+  void DonutAAG_Hline(long x1, long x2, long y)
+  {
+    //m_bmp.HLine(x1, x2+1, y, MakeRgbPixel(255,255,255));
+    long xleft = x1 < x2 ? x1 : x2;
+    long xright = (x1 < x2 ? x2 : x1) + 1;
+    m_pixels += xright - xleft;
+    m_bmp.BlendSpan(xleft, xright, y, MakeRgbPixel(255,255,255), GeomTestAlpha);
+  }
+
+  // the same drawing as the two callbacks above, as a span sink for the *Bands functions.  each
+  // band has its own copy, which adds its pixel count to the original's once when it's done;
+  // the original (on the calling thread, after the bands are joined) adds the lot to the test.
+  class Sink
+  {
+  public:
+    Sink(GeomTest* pTest) :
+      m_pTest(pTest),
+      m_pixels(0),
+      m_pBandPixels(&m_bandPixels),
+      m_bandPixels(0)
+    {
+    }
+
+    Sink(const Sink& rhs) :
+      m_pTest(rhs.m_pTest),
+      m_pixels(0),
+      m_pBandPixels(rhs.m_pBandPixels),
+      m_bandPixels(0)
+    {
+    }
+
+    ~Sink()
+    {
+      if(m_pBandPixels == &m_bandPixels)
+      {
+        m_pTest->m_pixels += m_pixels + m_bandPixels.load();
+      }
+      else
+      {
+        m_pBandPixels->fetch_add(m_pixels);
+      }
+    }
+
+    void AddSpan(long x1, long x2, long y)
+    {
+      m_pTest->m_bmp.BlendSpan(x1, x2 + 1, y, MakeRgbPixel(255,255,255), GeomTestAlpha);
+      m_pixels += x2 + 1 - x1;
+    }
+
+    void AddCoverage(long x, long y, BYTE c)
+    {
+      m_pTest->m_bmp.BlendPixel(x, y, MakeRgbPixel(255,0,0), static_cast<BYTE>((GeomTestAlpha * c) / 255));
+      m_pixels ++;
+    }
+
+  private:
+    Sink& operator=(const Sink&);
+
+    GeomTest* m_pTest;
+    long long m_pixels;
+    std::atomic<long long>* m_pBandPixels;// the original's m_bandPixels
+    std::atomic<long long> m_bandPixels;// what the bands added up to
+  };
+
+  // a mask the tests can rasterize into and composite from; it stays around between frames.
+  CoverageMask& GetMask()
+  {
+    return m_mask;
+  }
+
+  void CompositeMask(long x, long y, RgbPixel c)
+  {
+    m_pixels += m_mask.Composite(m_bmp, x, y, c);
+  }
+
+  // AA circles out of a stamp cache that also stays around between frames.
+  void StampCircle(long cx, long cy, long r, RgbPixel c)
+  {
+    m_pixels += m_stamps.DrawCircle(m_bmp, cx, cy, r, true, c);
+  }
+
+  // the clear at the start of each frame.  only erases the last frame's shapes if the bitmap is
+  // tracking what's dirty; those pixels count as touched.
+  void Clear(RgbPixel c)
+  {
+    if(m_bmp.GetDirtyTracking())
+    {
+      m_pixels += m_bmp.ClearDirty(c);
+    }
+    else
+    {
+      m_bmp.Fill(c);
+    }
+  }
+
+  // # of pixels touched by the callbacks since the last reset.
+  long long GetPixelCount() const
+  {
+    return m_pixels;
+  }
+
+  void ResetPixelCount()
+  {
+    m_pixels = 0;
+  }
+
+private:
+  Tbmp& m_bmp;
+  long long m_pixels;// calling thread only; see Sink
+  CoverageMask m_mask;
+  StampCache m_stamps;
+};
+
+
+// the line tests draw a fan of this many lines out from the center.
+const long GeomTestLines = 32;
+
+inline void GetGeomTestLineEnd(long i, long cx, long cy, long length, long& x, long& y)
+{
+  double a = (6.283185307179586 * i) / GeomTestLines;
+  x = cx + static_cast<long>(floor((cos(a) * length) + 0.5));
+  y = cy + static_cast<long>(floor((sin(a) * length) + 0.5));
+}
+
+
+// the circle grid tests cover the bitmap with small circles of 4 different sizes, the biggest
+// being radius/8+1, in the order they'd be laid out by hand: row by row with the sizes mixed.
+inline void GetGeomTestCircles(long w, long h, long radius, std::vector<CircleInstance>& circles)
+{
+  long rmax = (radius / 8) + 1;
+  long pitch = (2 * rmax) + 2;
+  long i = 0;
+  circles.clear();
+  for(long y = rmax + 1; y + rmax + 1 <= h; y += pitch)
+  {
+    for(long x = rmax + 1; x + rmax + 1 <= w; x += pitch)
+    {
+      CircleInstance c;
+      c.cx = x;
+      c.cy = y;
+      c.r = rmax - (((i % 4) * rmax) / 4);
+      circles.push_back(c);
+      i ++;
+    }
+  }
+}
+
+/*
+  Draws one frame of the given test, including the clear (see GeomTest::Clear()), and starts a
+  new frame for the scratch memory (see framearena.h).  Circles get "radius", donuts go from
+  "rin" out to "rout".  Ellipses are rout wide and rin high, and ellipse rings have a rin by rin/2
+  hole and are rout-rin thick.  The clipped test is the TID_DonutAAG donut moved so its center is
+  on the bottom right corner, clipped to the bitmap, so only a quarter of it is visible.  The
+  *AARows tests are the same circle and donut as TID_FilledCircleAAG / TID_DonutAAG, drawn in one
+  pass.  Lines are a fan of GeomTestLines from the center out to rout, and thick ones are rin/4+1
+  wide.  The circle grid tests draw GetGeomTestCircles() one call at a time, as one batch, and
+  through a ScanlineRenderer, and (in white, at full strength) as stamps from a StampCache (cx and
+  cy don't matter to them).  The ScanlineRenderer one also has a 4 pixel bar down the left edge
+  that starts 0x20000 rows above the bitmap, and it's clipped to the bitmap, so the far off top
+  has to be cut.  The mask test rasterizes the TID_DonutAAG donut into a CoverageMask
+  once and composites it 4 times, rin/2 apart, in 4 colors.  The tests that can use a FrameArena
+  get this thread's.  Returns false for tests that aren't implemented here (the GDI ones).
+*/
+template<typename Tbmp>
+bool DrawGeomTest(long TestID, Tbmp& bmp, GeomTest<Tbmp>& t, long cx, long cy, long radius, long rin, long rout)
+{
+  bool r = true;
+  FrameArena::NextFrame();
+  FrameArena* pArena = &FrameArena::Current();
+  t.Clear(MakeRgbPixel(0,0,0));
+
+  switch(TestID)
+  {
+  case TID_Fill:
+    break;
+  case TID_FilledCircleG:
+    FilledCircleG(cx, cy, radius,
+      &t, &GeomTest<Tbmp>::DonutAAG_Hline);
+    break;
+  case TID_FilledCircleAAG:
+    FilledCircleAAG(cx, cy, radius,
+      &t, &GeomTest<Tbmp>::DonutAAG_Hline,
+      &t, &GeomTest<Tbmp>::DonutAA2_SetAlphaPixel);
+    break;
+  case TID_DonutG:
+    DonutG(cx, cy, rin, rout-rin,
+      &t, &GeomTest<Tbmp>::DonutAAG_Hline);
+    break;
+  case TID_DonutAAG:
+    DonutAAG(cx, cy, rin, rout-rin,
+      &t, &GeomTest<Tbmp>::DonutAAG_Hline,
+      &t, &GeomTest<Tbmp>::DonutAA2_SetAlphaPixel);
+    break;
+  case TID_DonutAABands:
+    DonutAASpansBands(ThreadPool::Default(), cx, cy, rin, rout-rin,
+      typename GeomTest<Tbmp>::Sink(&t));
+    break;
+  case TID_FilledEllipseG:
+    FilledEllipseG(cx, cy, rout, rin,
+      &t, &GeomTest<Tbmp>::DonutAAG_Hline);
+    break;
+  case TID_FilledEllipseAAG:
+    FilledEllipseAAG(cx, cy, rout, rin,
+      &t, &GeomTest<Tbmp>::DonutAAG_Hline,
+      &t, &GeomTest<Tbmp>::DonutAA2_SetAlphaPixel);
+    break;
+  case TID_EllipseRingG:
+    EllipseRingG(cx, cy, rin, rin / 2, rout-rin,
+      &t, &GeomTest<Tbmp>::DonutAAG_Hline);
+    break;
+  case TID_DonutAAGClipped:
+    DonutAAClippedG(bmp.GetWidth(), bmp.GetHeight(), rin, rout-rin,
+      MakeClipRect(0, 0, bmp.GetWidth(), bmp.GetHeight()),
+      &t, &GeomTest<Tbmp>::DonutAAG_Hline,
+      &t, &GeomTest<Tbmp>::SetAlphaPixel);
+    break;
+  case TID_FilledCircleAARows:
+    FilledCircleAARowsG(cx, cy, radius, ClipRect::Everything(),
+      &t, &GeomTest<Tbmp>::DonutAAG_Hline,
+      &t, &GeomTest<Tbmp>::SetAlphaPixel, pArena);
+    break;
+  case TID_DonutAARows:
+    DonutAARowsG(cx, cy, rin, rout-rin, ClipRect::Everything(),
+      &t, &GeomTest<Tbmp>::DonutAAG_Hline,
+      &t, &GeomTest<Tbmp>::SetAlphaPixel, pArena);
+    break;
+  case TID_CircleGridAAG:
+  case TID_DrawCirclesAA:
+  case TID_ScanlineCirclesAA:
+  case TID_StampCirclesAA:
+    {
+      std::vector<CircleInstance> circles;
+      GetGeomTestCircles(bmp.GetWidth(), bmp.GetHeight(), radius, circles);
+      if(TestID == TID_DrawCirclesAA)
+      {
+        typename GeomTest<Tbmp>::Sink sink(&t);
+        DrawCirclesAA(circles.data(), circles.size(), ClipRect::Everything(), sink, pArena);
+      }
+      else if(TestID == TID_ScanlineCirclesAA)
+      {
+        ScanlineRenderer scene;
+        for(size_t i = 0; i < circles.size(); i ++)
+        {
+          scene.AddCircleAA(circles[i].cx, circles[i].cy, circles[i].r);
+        }
+        scene.AddRect(0, -0x20000, 4, bmp.GetHeight());
+        typename GeomTest<Tbmp>::Sink sink(&t);
+        scene.Draw(MakeClipRect(0, 0, bmp.GetWidth(), bmp.GetHeight()), sink, pArena);
+      }
+      else if(TestID == TID_StampCirclesAA)
+      {
+        for(size_t i = 0; i < circles.size(); i ++)
+        {
+          t.StampCircle(circles[i].cx, circles[i].cy, circles[i].r, MakeRgbPixel(255,255,255));
+        }
+      }
+      else
+      {
+        for(size_t i = 0; i < circles.size(); i ++)
+        {
+          FilledCircleAAG(circles[i].cx, circles[i].cy, circles[i].r,
+            &t, &GeomTest<Tbmp>::DonutAAG_Hline,
+            &t, &GeomTest<Tbmp>::DonutAA2_SetAlphaPixel);
+        }
+      }
+    }
+    break;
+  case TID_MaskCompositeAA:
+    {
+      // one rasterization, four composites
+      CoverageMask& mask = t.GetMask();
+      long d = rin / 2;
+      mask.SetSize((2 * rout) + 2, (2 * rout) + 2);
+      mask.Clear();
+      DonutAARows(rout + 1, rout + 1, rin, rout-rin, mask.GetClip(), mask, pArena);
+      t.CompositeMask(cx - rout - 1 - d, cy - rout - 1 - d, MakeRgbPixel(255,0,0));
+      t.CompositeMask(cx - rout - 1 + d, cy - rout - 1 - d, MakeRgbPixel(0,255,0));
+      t.CompositeMask(cx - rout - 1 - d, cy - rout - 1 + d, MakeRgbPixel(0,0,255));
+      t.CompositeMask(cx - rout - 1 + d, cy - rout - 1 + d, MakeRgbPixel(255,255,255));
+    }
+    break;
+  case TID_LineG:
+  case TID_LineAAG:
+  case TID_ThickLineAAG:
+    for(long i = 0; i < GeomTestLines; i ++)
+    {
+      long x, y;
+      GetGeomTestLineEnd(i, cx, cy, rout, x, y);
+      if(TestID == TID_LineG)
+      {
+        LineG(cx, cy, x, y,
+          &t, &GeomTest<Tbmp>::DonutAAG_Hline);
+      }
+      else if(TestID == TID_LineAAG)
+      {
+        LineAAG(cx, cy, x, y,
+          &t, &GeomTest<Tbmp>::SetAlphaPixel);
+      }
+      else
+      {
+        ThickLineAAG(cx, cy, x, y, (rin / 4) + 1,
+          &t, &GeomTest<Tbmp>::DonutAAG_Hline,
+          &t, &GeomTest<Tbmp>::SetAlphaPixel);
+      }
+    }
+    break;
+  default:
+    r = false;
+    break;
+  }
+  return r;
+}
+
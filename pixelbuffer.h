@@ -0,0 +1,460 @@
+/*
+  Low level pixel access to a 32bpp RgbPixel buffer that somebody else owns.  This holds all the
+  drawing primitives (SetPixel, HLine, Rect, Fill...) so that AnimBitmap (DIB section) and
+  SoftBitmap (plain aligned memory) share the exact same code.
+
+  Rows are m_pitch pixels apart, which may be more than the width (SoftBitmap pads its rows).
+
+  Dirty tracking: with SetDirtyTracking(true), every primitive here remembers which part of each
+  row it touched, so a frame can be cleared and shown without going over the whole surface:
+
+    bmp.ClearDirty(black);// erases only what was drawn last frame
+    ...draw...
+    bmp.BlitDirty(hdc, 0, 0);// (AnimBitmap) copies out only what changed, old and new
+
+  Anything that writes through GetBuffer() / GetRow() or GDI has to call AddDirtyRect() itself.
+  It's off by default and then costs one branch per primitive.
+*/
+
+
+#pragma once
+
+
+#include "platform.h"
+#include "colorframework.h"
+#include "pixelkernels.h"
+#include "profile.h"
+#include "spanbuffer.h"
+#include <vector>
+
+using namespace Colors;
+
+
+class PixelBuffer
+{
+public:
+  // GetDirtyRects() never hands back more than this many.
+  static const long MaxDirtyRects = 16;
+
+  PixelBuffer() :
+    m_x(0),
+    m_y(0),
+    m_pitch(0),
+    m_pbuf(0),
+    m_bDirty(false)
+  {
+  }
+
+  long GetWidth() const
+  {
+    return m_x;
+  }
+
+  long GetHeight() const
+  {
+    return m_y;
+  }
+
+  // distance between rows, in pixels.
+  long GetPitch() const
+  {
+    return m_pitch;
+  }
+
+  RgbPixel* GetBuffer()
+  {
+    return m_pbuf;
+  }
+
+  const RgbPixel* GetBuffer() const
+  {
+    return m_pbuf;
+  }
+
+  RgbPixel* GetRow(long y)
+  {
+    return m_pbuf + (y * m_pitch);
+  }
+
+  const RgbPixel* GetRow(long y) const
+  {
+    return m_pbuf + (y * m_pitch);
+  }
+
+  // no boundschecking for speed.
+  void SetPixel(long x, long y, RgbPixel c)
+  {
+    ATLASSERT(x >= 0);
+    ATLASSERT(y >= 0);
+    ATLASSERT(y < m_y);
+    ATLASSERT(x < m_x);
+    m_pbuf[x + (y * m_pitch)] = c;
+    Touch(x, x + 1, y);
+    GEOM_COUNT(PC_PixelsWritten, 1);
+  }
+
+  // xright is NOT drawn.
+  void HLine(long x1, long x2, long y, RgbPixel c)
+  {
+    long xleft = x1 < x2 ? x1 : x2;
+    long xright = x1 < x2 ? x2 : x1;
+    FillPixels(&m_pbuf[(y * m_pitch) + xleft], xright - xleft, c);
+    Touch(xleft, xright, y);
+    GEOM_COUNT(PC_Spans, 1);
+    GEOM_COUNT(PC_PixelsWritten, xright - xleft);
+  }
+
+  void VLine(long x, long y1, long y2, RgbPixel c)
+  {
+    long ytop = y1 < y2 ? y1 : y2;
+    long ybottom = y1 < y2 ? y2 : y1;
+    RgbPixel* pbuf = &m_pbuf[(ytop * m_pitch) + x];
+    GEOM_COUNT(PC_PixelsWritten, ybottom - ytop);
+    while(ytop != ybottom)
+    {
+      *pbuf = c;
+      Touch(x, x + 1, ytop);
+      pbuf += m_pitch;
+      ytop ++;
+    }
+  }
+
+  // b and r are not drawn
+  void Rect(long l, long t, long r, long b, RgbPixel c)
+  {
+    RgbPixel* pbuf = &m_pbuf[(t * m_pitch) + l];
+    long h = r - l;// horizontal size
+    bool bStream = (static_cast<double>(h) * (b - t) * sizeof(RgbPixel)) > PixelKernels::StreamThreshold;
+    GEOM_COUNT(PC_PixelsWritten, h * (b - t));
+    // fill downwards
+    while(t != b)
+    {
+      // draw a horizontal line
+      FillPixels(pbuf, h, c, bStream);
+      Touch(l, r, t);
+      pbuf += m_pitch;
+      t ++;
+    }
+  }
+
+  bool SetPixelSafe(long x, long y, RgbPixel c)
+  {
+    bool r = false;
+    if(x >= 0 && y >= 0 && x < m_x && y < m_y)
+    {
+      m_pbuf[x + (y * m_pitch)] = c;
+      Touch(x, x + 1, y);
+      GEOM_COUNT(PC_PixelsWritten, 1);
+      r = true;
+    }
+    return r;
+  }
+
+  // alpha blending, 0-255.  see pixelkernels.h for the math.
+  void BlendPixel(long x, long y, RgbPixel c, BYTE alpha)
+  {
+    RgbPixel* p = &m_pbuf[x + (y * m_pitch)];
+    *p = BlendPixelScalar(*p, c, alpha);
+    Touch(x, x + 1, y);
+    GEOM_COUNT(PC_PixelsBlended, 1);
+  }
+
+  // xright is NOT drawn, same as HLine.
+  void BlendSpan(long x1, long x2, long y, RgbPixel c, BYTE alpha)
+  {
+    long xleft = x1 < x2 ? x1 : x2;
+    long xright = x1 < x2 ? x2 : x1;
+    BlendPixels(&m_pbuf[(y * m_pitch) + xleft], xright - xleft, c, alpha);
+    Touch(xleft, xright, y);
+    GEOM_COUNT(PC_Spans, 1);
+    GEOM_COUNT(PC_PixelsBlended, xright - xleft);
+  }
+
+  // n pixels starting at x, each one blended with its own alpha from coverage[].
+  void BlendCoverageRow(long x, long y, const BYTE* coverage, long n, RgbPixel c)
+  {
+    BlendCoverage(&m_pbuf[(y * m_pitch) + x], coverage, n, c);
+    Touch(x, x + n, y);
+    GEOM_COUNT(PC_PixelsBlended, n);
+  }
+
+  RgbPixel GetPixel(long x, long y) const
+  {
+    return m_pbuf[x + (y * m_pitch)];
+  }
+
+  bool GetPixelSafe(RgbPixel& out, long x, long y) const
+  {
+    bool r = false;
+    if(x >= 0 && y >= 0 && x < m_x && y < m_y)
+    {
+      out = m_pbuf[x + (y * m_pitch)];
+      r = true;
+    }
+    return r;
+  }
+
+  // padding pixels at the end of each row get filled too; nobody looks at them.
+  void Fill(RgbPixel c)
+  {
+    GEOM_ZONE("PixelBuffer::Fill");
+    long n = m_pitch * m_y;
+    FillPixels(m_pbuf, n, c, (static_cast<double>(n) * sizeof(RgbPixel)) > PixelKernels::StreamThreshold);
+    GEOM_COUNT(PC_PixelsWritten, static_cast<long long>(m_x) * m_y);
+    AddDirtyRect(0, 0, m_x, m_y);
+  }
+
+  // turning it on marks the whole surface dirty, since nobody knows what's in it.
+  void SetDirtyTracking(bool b)
+  {
+    m_bDirty = b;
+    m_drawnLeft.clear();
+    m_drawnRight.clear();
+    m_staleLeft.clear();
+    m_staleRight.clear();
+    if(m_bDirty)
+    {
+      m_drawnLeft.resize(m_y, 0);
+      m_drawnRight.resize(m_y, m_x);
+      m_staleLeft.resize(m_y, m_x);
+      m_staleRight.resize(m_y, 0);
+    }
+  }
+
+  bool GetDirtyTracking() const
+  {
+    return m_bDirty;
+  }
+
+  // for drawing that didn't go through PixelBuffer.  clipped; right and bottom are not included.
+  void AddDirtyRect(long left, long top, long right, long bottom)
+  {
+    if(m_bDirty)
+    {
+      if(left < 0) left = 0;
+      if(top < 0) top = 0;
+      if(right > m_x) right = m_x;
+      if(bottom > m_y) bottom = m_y;
+      for(long y = top; (y < bottom) && (left < right); y ++)
+      {
+        Touch(left, right, y);
+      }
+    }
+  }
+
+  /*
+    Fills everything drawn since the last ClearDirty() with c, which should be whatever it was
+    cleared to before.  That's the whole surface the first time.  Returns how many pixels it
+    filled.  Does a Fill() when tracking is off.
+  */
+  long ClearDirty(RgbPixel c)
+  {
+    long n = 0;
+    if(!m_bDirty)
+    {
+      Fill(c);
+      n = m_x * m_y;
+    }
+    else
+    {
+      GEOM_ZONE("PixelBuffer::ClearDirty");
+      for(long y = 0; y < m_y; y ++)
+      {
+        long left = m_drawnLeft[y];
+        long right = m_drawnRight[y];
+        if(left < right)
+        {
+          FillPixels(GetRow(y) + left, right - left, c);
+          n += right - left;
+          // it's changed since the last present, even if nothing gets drawn there again
+          if(left < m_staleLeft[y]) m_staleLeft[y] = left;
+          if(right > m_staleRight[y]) m_staleRight[y] = right;
+          m_drawnLeft[y] = m_x;
+          m_drawnRight[y] = 0;
+        }
+      }
+      GEOM_COUNT(PC_PixelsWritten, n);
+    }
+    return n;
+  }
+
+  /*
+    What changed since the last MarkPresented(): everything drawn plus everything ClearDirty()
+    erased.  Rows are merged into at most nMax (up to MaxDirtyRects) rectangles, wasting a bit of
+    area to keep the count down.  Returns how many there are.  Tracking off = one rect, all of it.
+  */
+  long GetDirtyRects(ClipRect* pRects, long nMax) const
+  {
+    long n = 0;
+    long area = 0;// exact area of the open rect (pRects[n-1]) when bOpen
+    bool bOpen = false;
+
+    if(nMax > MaxDirtyRects) nMax = MaxDirtyRects;
+    if(nMax < 1)
+    {
+      return 0;
+    }
+    if(!m_bDirty)
+    {
+      pRects[0] = MakeClipRect(0, 0, m_x, m_y);
+      return (m_x > 0 && m_y > 0) ? 1 : 0;
+    }
+
+    for(long y = 0; y < m_y; y ++)
+    {
+      long left = m_drawnLeft[y] < m_staleLeft[y] ? m_drawnLeft[y] : m_staleLeft[y];
+      long right = m_drawnRight[y] > m_staleRight[y] ? m_drawnRight[y] : m_staleRight[y];
+      if(left >= right)
+      {
+        bOpen = false;
+        continue;
+      }
+
+      if(bOpen)
+      {
+        // keep growing the rect down while it's no more than 1/4 wasted
+        ClipRect& rc = pRects[n - 1];
+        long ul = left < rc.left ? left : rc.left;
+        long ur = right > rc.right ? right : rc.right;
+        long exact = area + (right - left);
+        if(((ur - ul) * (y + 1 - rc.top)) - exact <= (exact >> 2))
+        {
+          rc.left = ul;
+          rc.right = ur;
+          rc.bottom = y + 1;
+          area = exact;
+          continue;
+        }
+      }
+
+      if(n == nMax && n == 1)
+      {
+        // only room for one, so it's everything
+        ClipRect& rc = pRects[0];
+        if(left < rc.left) rc.left = left;
+        if(right > rc.right) rc.right = right;
+        rc.bottom = y + 1;
+        continue;
+      }
+      if(n == nMax)
+      {
+        MergeDirtyRects(pRects, n);
+      }
+      pRects[n ++] = MakeClipRect(left, y, right, y + 1);
+      area = right - left;
+      bOpen = true;
+    }
+    return n;
+  }
+
+  // for swap chains (see swapchain.h), where what's on screen came from another buffer: the rows
+  // drawn since the last ClearDirty(), and adding some other buffer's to what GetDirtyRects()
+  // reports.  rows that don't match our size mean all of it.
+  void GetDrawnRows(std::vector<long>& left, std::vector<long>& right) const
+  {
+    left = m_drawnLeft;
+    right = m_drawnRight;
+  }
+
+  void AddStaleRows(const std::vector<long>& left, const std::vector<long>& right)
+  {
+    if(m_bDirty)
+    {
+      bool bAll = (left.size() != static_cast<size_t>(m_y)) || (right.size() != static_cast<size_t>(m_y));
+      for(long y = 0; y < m_y; y ++)
+      {
+        long l = bAll ? 0 : left[y];
+        long r = bAll ? m_x : (right[y] < m_x ? right[y] : m_x);
+        if(l < m_staleLeft[y]) m_staleLeft[y] = l;
+        if(r > m_staleRight[y]) m_staleRight[y] = r;
+      }
+    }
+  }
+
+  // call after GetDirtyRects() has been copied out; it starts over from what's drawn now.
+  void MarkPresented()
+  {
+    if(m_bDirty)
+    {
+      for(long y = 0; y < m_y; y ++)
+      {
+        m_staleLeft[y] = m_x;
+        m_staleRight[y] = 0;
+      }
+    }
+  }
+
+protected:
+  // derived classes call this whenever their memory changes.
+  void Attach(RgbPixel* pbuf, long x, long y, long pitch)
+  {
+    m_pbuf = pbuf;
+    m_x = x;
+    m_y = y;
+    m_pitch = pitch;
+    SetDirtyTracking(m_bDirty);
+  }
+
+  long m_x;
+  long m_y;
+  long m_pitch;
+  RgbPixel* m_pbuf;
+
+private:
+  // [x1, x2) on row y.  empty spans (x1 >= x2) don't count, so they can't widen the row.
+  inline void Touch(long x1, long x2, long y)
+  {
+    if(m_bDirty && (x1 < x2))
+    {
+      if(x1 < m_drawnLeft[y]) m_drawnLeft[y] = x1;
+      if(x2 > m_drawnRight[y]) m_drawnRight[y] = x2;
+    }
+  }
+
+  // makes room for one more by joining the two neighbors (they're in row order) whose union
+  // wastes the least.
+  static void MergeDirtyRects(ClipRect* pRects, long& n)
+  {
+    long best = 0;
+    long bestWaste = -1;
+    for(long i = 0; i + 1 < n; i ++)
+    {
+      const ClipRect& a = pRects[i];
+      const ClipRect& b = pRects[i + 1];
+      long ul = a.left < b.left ? a.left : b.left;
+      long ur = a.right > b.right ? a.right : b.right;
+      long waste = ((ur - ul) * (b.bottom - a.top))
+        - ((a.right - a.left) * (a.bottom - a.top))
+        - ((b.right - b.left) * (b.bottom - b.top));
+      if(bestWaste < 0 || waste < bestWaste)
+      {
+        best = i;
+        bestWaste = waste;
+      }
+    }
+
+    ClipRect& a = pRects[best];
+    const ClipRect& b = pRects[best + 1];
+    if(b.left < a.left) a.left = b.left;
+    if(b.right > a.right) a.right = b.right;
+    a.bottom = b.bottom;
+    for(long i = best + 1; i + 1 < n; i ++)
+    {
+      pRects[i] = pRects[i + 1];
+    }
+    n --;
+  }
+
+  bool m_bDirty;
+  // per row, what's been drawn since the last ClearDirty() is m_drawnLeft[y] <= x < m_drawnRight[y],
+  // and what ClearDirty() erased since the last MarkPresented() is the same in m_stale*.
+  std::vector<long> m_drawnLeft;
+  std::vector<long> m_drawnRight;
+  std::vector<long> m_staleLeft;
+  std::vector<long> m_staleRight;
+
+  // it doesnt own the memory, so copying one around would just be confusing.
+  PixelBuffer(const PixelBuffer&);
+  PixelBuffer& operator = (const PixelBuffer&);
+};
+
@@ -0,0 +1,625 @@
+/*
+  The inner loops of PixelBuffer.  Each kernel comes in a scalar version and SSE2 / AVX2 / AVX-512
+  versions.  Which one gets used is decided once, from CPUID, the first time any of them is
+  called.  All versions write exactly the same pixels, so SetPixelKernelLevel() can force a
+  lower level for comparisons.
+
+  Fills that are bigger than StreamThreshold bytes (full screen clears, basically) use
+  non-temporal stores so they dont push everything else out of the cache.
+
+  Blending is 8 bit fixed point: out = (src*a + dst*(255-a)) / 255, rounded, on all 4 bytes of
+  the pixel.  The divide is done as (t + (t >> 8)) >> 8 with t = src*a + dst*(255-a) + 128, which
+  is exact for this range, so there are no divisions anywhere and every level gives the same
+  result.  AVX-512 here means F + BW, since the blends need 16 bit lanes.
+
+  Non-x86 builds just get the scalar versions.
+*/
+
+
+#pragma once
+
+
+#include "platform.h"
+#include "colorframework.h"
+
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define GEOM_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// lets us use AVX2 / AVX-512 intrinsics in individual functions without compiling the whole
+// program for those instruction sets.  msvc doesnt need to be told.
+#if defined(__GNUC__) || defined(__clang__)
+#define GEOM_TARGET(x) __attribute__((target(x)))
+#else
+#define GEOM_TARGET(x)
+#endif
+
+#if defined(GEOM_X86) && (!defined(_MSC_VER) || (_MSC_VER >= 1911))
+#define GEOM_AVX512 1
+#endif
+
+using namespace Colors;
+
+
+const long PK_Scalar = 0;
+const long PK_SSE2 = 1;
+const long PK_AVX2 = 2;
+const long PK_AVX512 = 3;
+
+
+inline const char* GetPixelKernelName(long level)
+{
+  switch(level)
+  {
+  case PK_Scalar: return "scalar";
+  case PK_SSE2: return "sse2";
+  case PK_AVX2: return "avx2";
+  case PK_AVX512: return "avx512";
+  }
+  return "?";
+}
+
+
+// the best level this cpu + OS can run.
+inline long DetectPixelKernelLevel()
+{
+  long r = PK_Scalar;
+#ifdef GEOM_X86
+  unsigned int regs1[4] = {0};// eax ebx ecx edx for leaf 1
+  unsigned int regs7[4] = {0};// leaf 7, subleaf 0
+  unsigned int maxleaf = 0;
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  maxleaf = info[0];
+  __cpuid(info, 1);
+  for(int i = 0; i < 4; i ++) regs1[i] = info[i];
+  if(maxleaf >= 7)
+  {
+    __cpuidex(info, 7, 0);
+    for(int i = 0; i < 4; i ++) regs7[i] = info[i];
+  }
+#else
+  maxleaf = __get_cpuid_max(0, 0);
+  __get_cpuid(1, &regs1[0], &regs1[1], &regs1[2], &regs1[3]);
+  if(maxleaf >= 7)
+  {
+    __cpuid_count(7, 0, regs7[0], regs7[1], regs7[2], regs7[3]);
+  }
+#endif
+
+  if(regs1[3] & (1 << 26))
+  {
+    r = PK_SSE2;
+  }
+
+  // AVX needs the OS to save the YMM (and for AVX-512, ZMM) registers; ask XCR0.
+  bool osxsave = (regs1[2] & (1 << 27)) != 0;
+  bool avx = (regs1[2] & (1 << 28)) != 0;
+  if(osxsave && avx)
+  {
+#ifdef _MSC_VER
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int xlo, xhi;
+    __asm__ __volatile__("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+    unsigned long long xcr0 = (static_cast<unsigned long long>(xhi) << 32) | xlo;
+#endif
+    if(((xcr0 & 0x6) == 0x6) && (regs7[1] & (1 << 5)))
+    {
+      r = PK_AVX2;
+#ifdef GEOM_AVX512
+      if(((xcr0 & 0xE6) == 0xE6) && (regs7[1] & (1 << 16)) && (regs7[1] & (1u << 30)))
+      {
+        r = PK_AVX512;
+      }
+#endif
+    }
+  }
+#endif
+  return r;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// fill n pixels with c.  bStream = use non-temporal stores.
+typedef void (*FillPixelsProc)(RgbPixel* p, long n, RgbPixel c, bool bStream);
+
+inline void FillPixels_Scalar(RgbPixel* p, long n, RgbPixel c, bool bStream)
+{
+  (void)bStream;// plain stores only
+  for(long i = 0; i < n; i ++)
+  {
+    p[i] = c;
+  }
+}
+
+#ifdef GEOM_X86
+
+// scalar until p is aligned to "align" bytes; returns how many pixels that took.
+inline long FillPixelsHead(RgbPixel* p, long n, RgbPixel c, size_t align)
+{
+  long i = 0;
+  while((i < n) && (reinterpret_cast<size_t>(p + i) & (align - 1)))
+  {
+    p[i] = c;
+    i ++;
+  }
+  return i;
+}
+
+inline void FillPixels_SSE2(RgbPixel* p, long n, RgbPixel c, bool bStream)
+{
+  long i = FillPixelsHead(p, n, c, 16);
+  __m128i v = _mm_set1_epi32(static_cast<int>(c));
+  if(bStream)
+  {
+    for(; i + 16 <= n; i += 16)
+    {
+      _mm_stream_si128(reinterpret_cast<__m128i*>(p + i), v);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(p + i + 4), v);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(p + i + 8), v);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(p + i + 12), v);
+    }
+    _mm_sfence();
+  }
+  else
+  {
+    for(; i + 16 <= n; i += 16)
+    {
+      _mm_store_si128(reinterpret_cast<__m128i*>(p + i), v);
+      _mm_store_si128(reinterpret_cast<__m128i*>(p + i + 4), v);
+      _mm_store_si128(reinterpret_cast<__m128i*>(p + i + 8), v);
+      _mm_store_si128(reinterpret_cast<__m128i*>(p + i + 12), v);
+    }
+  }
+  for(; i + 4 <= n; i += 4)
+  {
+    _mm_store_si128(reinterpret_cast<__m128i*>(p + i), v);
+  }
+  for(; i < n; i ++)
+  {
+    p[i] = c;
+  }
+}
+
+GEOM_TARGET("avx2")
+inline void FillPixels_AVX2(RgbPixel* p, long n, RgbPixel c, bool bStream)
+{
+  long i = FillPixelsHead(p, n, c, 32);
+  __m256i v = _mm256_set1_epi32(static_cast<int>(c));
+  if(bStream)
+  {
+    for(; i + 32 <= n; i += 32)
+    {
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(p + i), v);
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(p + i + 8), v);
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(p + i + 16), v);
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(p + i + 24), v);
+    }
+    _mm_sfence();
+  }
+  else
+  {
+    for(; i + 32 <= n; i += 32)
+    {
+      _mm256_store_si256(reinterpret_cast<__m256i*>(p + i), v);
+      _mm256_store_si256(reinterpret_cast<__m256i*>(p + i + 8), v);
+      _mm256_store_si256(reinterpret_cast<__m256i*>(p + i + 16), v);
+      _mm256_store_si256(reinterpret_cast<__m256i*>(p + i + 24), v);
+    }
+  }
+  for(; i + 8 <= n; i += 8)
+  {
+    _mm256_store_si256(reinterpret_cast<__m256i*>(p + i), v);
+  }
+  for(; i < n; i ++)
+  {
+    p[i] = c;
+  }
+}
+
+#ifdef GEOM_AVX512
+GEOM_TARGET("avx512f")
+inline void FillPixels_AVX512(RgbPixel* p, long n, RgbPixel c, bool bStream)
+{
+  long i = FillPixelsHead(p, n, c, 64);
+  __m512i v = _mm512_set1_epi32(static_cast<int>(c));
+  if(bStream)
+  {
+    for(; i + 64 <= n; i += 64)
+    {
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(p + i), v);
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(p + i + 16), v);
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(p + i + 32), v);
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(p + i + 48), v);
+    }
+    _mm_sfence();
+  }
+  else
+  {
+    for(; i + 64 <= n; i += 64)
+    {
+      _mm512_store_si512(reinterpret_cast<__m512i*>(p + i), v);
+      _mm512_store_si512(reinterpret_cast<__m512i*>(p + i + 16), v);
+      _mm512_store_si512(reinterpret_cast<__m512i*>(p + i + 32), v);
+      _mm512_store_si512(reinterpret_cast<__m512i*>(p + i + 48), v);
+    }
+  }
+  for(; i + 16 <= n; i += 16)
+  {
+    _mm512_store_si512(reinterpret_cast<__m512i*>(p + i), v);
+  }
+  if(i < n)
+  {
+    // the last 1-15 pixels in one masked store
+    __mmask16 m = static_cast<__mmask16>((1u << (n - i)) - 1);
+    _mm512_mask_storeu_epi32(p + i, m, v);
+  }
+}
+#endif
+
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// blend c over n pixels with a constant alpha (0-255)
+typedef void (*BlendPixelsProc)(RgbPixel* p, long n, RgbPixel c, BYTE alpha);
+// blend c over n pixels, alpha for each pixel comes from coverage[]
+typedef void (*BlendCoverageProc)(RgbPixel* p, const BYTE* coverage, long n, RgbPixel c);
+
+// the scalar reference.  does R+B and A+G as two pairs of 16 bit fields in one 32 bit multiply.
+inline RgbPixel BlendPixelScalar(RgbPixel d, RgbPixel c, DWORD alpha)
+{
+  DWORD inv = 255 - alpha;
+  DWORD rb = ((c & 0x00FF00FF) * alpha) + ((d & 0x00FF00FF) * inv) + 0x00800080;
+  DWORD ag = (((c >> 8) & 0x00FF00FF) * alpha) + (((d >> 8) & 0x00FF00FF) * inv) + 0x00800080;
+  rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+  ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+  return rb | ag;
+}
+
+inline void BlendPixels_Scalar(RgbPixel* p, long n, RgbPixel c, BYTE alpha)
+{
+  for(long i = 0; i < n; i ++)
+  {
+    p[i] = BlendPixelScalar(p[i], c, alpha);
+  }
+}
+
+inline void BlendCoverage_Scalar(RgbPixel* p, const BYTE* coverage, long n, RgbPixel c)
+{
+  for(long i = 0; i < n; i ++)
+  {
+    p[i] = BlendPixelScalar(p[i], c, coverage[i]);
+  }
+}
+
+#ifdef GEOM_X86
+
+// 8 16-bit channels: (c*a + d*inv + 128) / 255
+inline __m128i BlendWords_SSE2(__m128i d, __m128i c, __m128i a, __m128i inv)
+{
+  __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(c, a), _mm_mullo_epi16(d, inv)), _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// 4 pixels.  a / inv are already expanded to one word per channel (lo = pixels 0,1; hi = 2,3)
+inline __m128i Blend4_SSE2(__m128i d, __m128i clo, __m128i chi, __m128i alo, __m128i ahi, __m128i invlo, __m128i invhi)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = BlendWords_SSE2(_mm_unpacklo_epi8(d, zero), clo, alo, invlo);
+  __m128i hi = BlendWords_SSE2(_mm_unpackhi_epi8(d, zero), chi, ahi, invhi);
+  return _mm_packus_epi16(lo, hi);
+}
+
+inline void BlendPixels_SSE2(RgbPixel* p, long n, RgbPixel c, BYTE alpha)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i cw = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(c)), zero);
+  __m128i a = _mm_set1_epi16(alpha);
+  __m128i inv = _mm_set1_epi16(static_cast<short>(255 - alpha));
+  long i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), Blend4_SSE2(d, cw, cw, a, a, inv, inv));
+  }
+  for(; i < n; i ++)
+  {
+    p[i] = BlendPixelScalar(p[i], c, alpha);
+  }
+}
+
+inline void BlendCoverage_SSE2(RgbPixel* p, const BYTE* coverage, long n, RgbPixel c)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i cw = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(c)), zero);
+  __m128i ff = _mm_set1_epi16(255);
+  long i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    int cov4;
+    memcpy(&cov4, coverage + i, 4);
+    // c0 c1 c2 c3 -> c0 c0 c0 c0 c1 c1 c1 c1 ...
+    __m128i a = _mm_cvtsi32_si128(cov4);
+    a = _mm_unpacklo_epi8(a, a);
+    a = _mm_unpacklo_epi16(a, a);
+    __m128i alo = _mm_unpacklo_epi8(a, zero);
+    __m128i ahi = _mm_unpackhi_epi8(a, zero);
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i),
+      Blend4_SSE2(d, cw, cw, alo, ahi, _mm_sub_epi16(ff, alo), _mm_sub_epi16(ff, ahi)));
+  }
+  for(; i < n; i ++)
+  {
+    p[i] = BlendPixelScalar(p[i], c, coverage[i]);
+  }
+}
+
+GEOM_TARGET("avx2")
+inline __m256i BlendWords_AVX2(__m256i d, __m256i c, __m256i a, __m256i inv)
+{
+  __m256i t = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(c, a), _mm256_mullo_epi16(d, inv)), _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+// 8 pixels.  unpack / pack both work inside 128 bit lanes, so pixel order comes back out intact.
+GEOM_TARGET("avx2")
+inline __m256i Blend8_AVX2(__m256i d, __m256i cw, __m256i a, __m256i ff)
+{
+  __m256i zero = _mm256_setzero_si256();
+  __m256i alo = _mm256_unpacklo_epi8(a, zero);
+  __m256i ahi = _mm256_unpackhi_epi8(a, zero);
+  __m256i lo = BlendWords_AVX2(_mm256_unpacklo_epi8(d, zero), cw, alo, _mm256_sub_epi16(ff, alo));
+  __m256i hi = BlendWords_AVX2(_mm256_unpackhi_epi8(d, zero), cw, ahi, _mm256_sub_epi16(ff, ahi));
+  return _mm256_packus_epi16(lo, hi);
+}
+
+GEOM_TARGET("avx2")
+inline void BlendPixels_AVX2(RgbPixel* p, long n, RgbPixel c, BYTE alpha)
+{
+  __m256i cw = _mm256_unpacklo_epi8(_mm256_set1_epi32(static_cast<int>(c)), _mm256_setzero_si256());
+  __m256i a = _mm256_set1_epi8(static_cast<char>(alpha));
+  __m256i ff = _mm256_set1_epi16(255);
+  long i = 0;
+  for(; i + 8 <= n; i += 8)
+  {
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), Blend8_AVX2(d, cw, a, ff));
+  }
+  for(; i < n; i ++)
+  {
+    p[i] = BlendPixelScalar(p[i], c, alpha);
+  }
+}
+
+GEOM_TARGET("avx2")
+inline void BlendCoverage_AVX2(RgbPixel* p, const BYTE* coverage, long n, RgbPixel c)
+{
+  __m256i cw = _mm256_unpacklo_epi8(_mm256_set1_epi32(static_cast<int>(c)), _mm256_setzero_si256());
+  __m256i ff = _mm256_set1_epi16(255);
+  // each coverage byte out to all 4 bytes of its pixel; pixels 0-3 in the low lane, 4-7 in the high.
+  __m256i expand = _mm256_setr_epi8(
+    0,0,0,0, 1,1,1,1, 2,2,2,2, 3,3,3,3,
+    4,4,4,4, 5,5,5,5, 6,6,6,6, 7,7,7,7);
+  long i = 0;
+  for(; i + 8 <= n; i += 8)
+  {
+    __m256i a = _mm256_broadcastq_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(coverage + i)));
+    a = _mm256_shuffle_epi8(a, expand);
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), Blend8_AVX2(d, cw, a, ff));
+  }
+  for(; i < n; i ++)
+  {
+    p[i] = BlendPixelScalar(p[i], c, coverage[i]);
+  }
+}
+
+#ifdef GEOM_AVX512
+GEOM_TARGET("avx512f,avx512bw")
+inline __m512i Blend16_AVX512(__m512i d, __m512i cw, __m512i a, __m512i ff)
+{
+  __m512i zero = _mm512_setzero_si512();
+  __m512i r128 = _mm512_set1_epi16(128);
+  __m512i alo = _mm512_unpacklo_epi8(a, zero);
+  __m512i ahi = _mm512_unpackhi_epi8(a, zero);
+  __m512i tlo = _mm512_add_epi16(_mm512_add_epi16(_mm512_mullo_epi16(cw, alo), _mm512_mullo_epi16(_mm512_unpacklo_epi8(d, zero), _mm512_sub_epi16(ff, alo))), r128);
+  __m512i thi = _mm512_add_epi16(_mm512_add_epi16(_mm512_mullo_epi16(cw, ahi), _mm512_mullo_epi16(_mm512_unpackhi_epi8(d, zero), _mm512_sub_epi16(ff, ahi))), r128);
+  tlo = _mm512_srli_epi16(_mm512_add_epi16(tlo, _mm512_srli_epi16(tlo, 8)), 8);
+  thi = _mm512_srli_epi16(_mm512_add_epi16(thi, _mm512_srli_epi16(thi, 8)), 8);
+  return _mm512_packus_epi16(tlo, thi);
+}
+
+GEOM_TARGET("avx512f,avx512bw")
+inline void BlendPixels_AVX512(RgbPixel* p, long n, RgbPixel c, BYTE alpha)
+{
+  __m512i cw = _mm512_unpacklo_epi8(_mm512_set1_epi32(static_cast<int>(c)), _mm512_setzero_si512());
+  __m512i a = _mm512_set1_epi8(static_cast<char>(alpha));
+  __m512i ff = _mm512_set1_epi16(255);
+  long i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    __m512i d = _mm512_loadu_si512(p + i);
+    _mm512_storeu_si512(p + i, Blend16_AVX512(d, cw, a, ff));
+  }
+  if(i < n)
+  {
+    __mmask16 m = static_cast<__mmask16>((1u << (n - i)) - 1);
+    __m512i d = _mm512_maskz_loadu_epi32(m, p + i);
+    _mm512_mask_storeu_epi32(p + i, m, Blend16_AVX512(d, cw, a, ff));
+  }
+}
+
+GEOM_TARGET("avx512f,avx512bw")
+inline void BlendCoverage_AVX512(RgbPixel* p, const BYTE* coverage, long n, RgbPixel c)
+{
+  __m512i cw = _mm512_unpacklo_epi8(_mm512_set1_epi32(static_cast<int>(c)), _mm512_setzero_si512());
+  __m512i ff = _mm512_set1_epi16(255);
+  // 16 coverage bytes in every lane, then lane k picks out bytes 4k..4k+3, 4 times each.  (the
+  // maskz broadcast is the same as the plain one; gcc's plain one warns about an uninitialized
+  // temporary at -Wall.)
+  __m512i expand = _mm512_set_epi32(
+    0x0F0F0F0F, 0x0E0E0E0E, 0x0D0D0D0D, 0x0C0C0C0C,
+    0x0B0B0B0B, 0x0A0A0A0A, 0x09090909, 0x08080808,
+    0x07070707, 0x06060606, 0x05050505, 0x04040404,
+    0x03030303, 0x02020202, 0x01010101, 0x00000000);
+  long i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    __m512i a = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_loadu_si128(reinterpret_cast<const __m128i*>(coverage + i)));
+    a = _mm512_shuffle_epi8(a, expand);
+    __m512i d = _mm512_loadu_si512(p + i);
+    _mm512_storeu_si512(p + i, Blend16_AVX512(d, cw, a, ff));
+  }
+  if(i < n)
+  {
+    // dont read past the end of coverage[]
+    BYTE tail[16] = { 0 };
+    memcpy(tail, coverage + i, n - i);
+    __mmask16 m = static_cast<__mmask16>((1u << (n - i)) - 1);
+    __m512i a = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail)));
+    a = _mm512_shuffle_epi8(a, expand);
+    __m512i d = _mm512_maskz_loadu_epi32(m, p + i);
+    _mm512_mask_storeu_epi32(p + i, m, Blend16_AVX512(d, cw, a, ff));
+  }
+}
+#endif
+
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// the dispatch table.
+class PixelKernels
+{
+public:
+  // fills bigger than this many bytes use non-temporal stores.
+  static const long StreamThreshold = 4 * 1024 * 1024;
+
+  // spans shorter than this arent worth an indirect call.
+  static const long MinKernelPixels = 16;
+
+  FillPixelsProc pFill;
+  BlendPixelsProc pBlend;
+  BlendCoverageProc pBlendCoverage;
+
+  static PixelKernels& Get()
+  {
+    static PixelKernels k(DetectPixelKernelLevel());
+    return k;
+  }
+
+  long GetLevel() const
+  {
+    return m_level;
+  }
+
+  // forces a level.  it will never go above what DetectPixelKernelLevel() says.
+  // not thread safe; do it at startup.
+  void SetLevel(long level)
+  {
+    long max = DetectPixelKernelLevel();
+    if(level > max) level = max;
+    if(level < PK_Scalar) level = PK_Scalar;
+    m_level = level;
+
+    pFill = FillPixels_Scalar;
+    pBlend = BlendPixels_Scalar;
+    pBlendCoverage = BlendCoverage_Scalar;
+#ifdef GEOM_X86
+    switch(level)
+    {
+    case PK_SSE2:
+      pFill = FillPixels_SSE2;
+      pBlend = BlendPixels_SSE2;
+      pBlendCoverage = BlendCoverage_SSE2;
+      break;
+    case PK_AVX2:
+      pFill = FillPixels_AVX2;
+      pBlend = BlendPixels_AVX2;
+      pBlendCoverage = BlendCoverage_AVX2;
+      break;
+#ifdef GEOM_AVX512
+    case PK_AVX512:
+      pFill = FillPixels_AVX512;
+      pBlend = BlendPixels_AVX512;
+      pBlendCoverage = BlendCoverage_AVX512;
+      break;
+#endif
+    }
+#endif
+  }
+
+private:
+  PixelKernels(long level)
+  {
+    SetLevel(level);
+  }
+
+  long m_level;
+};
+
+
+inline void SetPixelKernelLevel(long level)
+{
+  PixelKernels::Get().SetLevel(level);
+}
+
+inline long GetPixelKernelLevel()
+{
+  return PixelKernels::Get().GetLevel();
+}
+
+
+// short runs stay inline; anything longer goes to the best kernel.
+inline void FillPixels(RgbPixel* p, long n, RgbPixel c, bool bStream = false)
+{
+  if(n < PixelKernels::MinKernelPixels)
+  {
+    for(long i = 0; i < n; i ++)
+    {
+      p[i] = c;
+    }
+  }
+  else
+  {
+    PixelKernels::Get().pFill(p, n, c, bStream);
+  }
+}
+
+
+inline void BlendPixels(RgbPixel* p, long n, RgbPixel c, BYTE alpha)
+{
+  if(n < PixelKernels::MinKernelPixels)
+  {
+    BlendPixels_Scalar(p, n, c, alpha);
+  }
+  else
+  {
+    PixelKernels::Get().pBlend(p, n, c, alpha);
+  }
+}
+
+
+inline void BlendCoverage(RgbPixel* p, const BYTE* coverage, long n, RgbPixel c)
+{
+  if(n < PixelKernels::MinKernelPixels)
+  {
+    BlendCoverage_Scalar(p, coverage, n, c);
+  }
+  else
+  {
+    PixelKernels::Get().pBlendCoverage(p, coverage, n, c);
+  }
+}
+
@@ -0,0 +1,97 @@
+/*
+  Minimal portability layer.  On Windows this just pulls in windows.h like everything used to.
+  Everywhere else it provides the handful of windows types and keywords the headers in this
+  project depend on (BYTE, DWORD, __stdcall, __int8...) plus aligned allocation, so that the
+  rasterizers, Blob and SoftBitmap compile without any windows headers.
+
+  Anything that actually needs GDI (AnimBitmap, the test app) still includes windows.h itself.
+*/
+
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <malloc.h>
+
+#else
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int64_t LONGLONG;
+
+#define __stdcall
+#define __int8 char
+#define __int16 short
+#define __int32 int
+#define __int64 long long
+
+#endif
+
+
+#ifndef ATLASSERT
+#include <assert.h>
+#define ATLASSERT(expr) assert(expr)
+#endif
+
+
+// allocates memory aligned to "alignment" bytes, which must be a power of 2.  free with AlignedFree().
+inline void* AlignedAlloc(size_t bytes, size_t alignment)
+{
+#ifdef _WIN32
+  return _aligned_malloc(bytes, alignment);
+#else
+  void* r = 0;
+  if(alignment < sizeof(void*))
+  {
+    alignment = sizeof(void*);
+  }
+  if(posix_memalign(&r, alignment, bytes))
+  {
+    r = 0;
+  }
+  return r;
+#endif
+}
+
+inline void AlignedFree(void* p)
+{
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+}
+
+
+const size_t PageSize = 4096;
+const size_t HugePageSize = 2 * 1024 * 1024;
+
+// asks the OS to back this memory with huge pages.  only a hint, and only the huge pages that fit
+// entirely inside get used, so it's for big HugePageSize-aligned blocks.  does nothing on windows,
+// where large pages need a privilege and have to be asked for up front.
+inline void AdviseHugePages(void* p, size_t bytes)
+{
+#ifdef MADV_HUGEPAGE
+  size_t start = (reinterpret_cast<size_t>(p) + PageSize - 1) & ~(PageSize - 1);
+  size_t end = (reinterpret_cast<size_t>(p) + bytes) & ~(PageSize - 1);
+  if(end > start)
+  {
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_HUGEPAGE);
+  }
+#else
+  (void)p;
+  (void)bytes;
+#endif
+}
@@ -0,0 +1,272 @@
+/*
+  Scoped timing zones and counters for the hot paths, and a Chrome trace dump of them, for finding
+  out where a frame's time goes (table init vs. span filling vs. AA vs. blit).
+
+  It's all compiled out unless GEOM_PROFILE is 1 (define it before including anything, or on the
+  command line).  Turned off, every macro here expands to nothing and there's no Profiler.
+
+    void DrawStuff()
+    {
+      GEOM_ZONE("DrawStuff");// timed from here to the end of the scope
+      ...
+      GEOM_COUNT(PC_Spans, 1);
+    }
+
+    // once per frame, after drawing, with the surface area (for the overdraw counter)
+    GEOM_PROFILE_FRAME(bmp.GetWidth() * bmp.GetHeight());
+
+    // and at the end
+    Profiler::WriteChromeTrace("trace.json");// load in chrome://tracing or ui.perfetto.dev
+
+  Zones and counters go into the calling thread's own buffers, so there's no locking except the
+  first time a thread shows up.  Each thread gets its own track in the trace.  A thread keeps at
+  most MaxEvents zones; after that they're counted as dropped.
+
+  GEOM_PROFILE_FRAME() adds up every thread's counters into one sample for the frame and zeroes
+  them.  Like FrameArena::NextFrame(), don't call it while other threads are still drawing.
+  "overdraw" in the samples is pixels written + pixels blended - area: how many pixel writes went
+  on top of something already written that frame (the clear counts as a write).
+*/
+
+
+#pragma once
+
+
+#ifndef GEOM_PROFILE
+#define GEOM_PROFILE 0
+#endif
+
+
+enum ProfileCounter
+{
+  PC_Spans,// HLine()s and BlendSpan()s
+  PC_PixelsWritten,
+  PC_PixelsBlended,
+  PC_TableHits,// circle table cache
+  PC_TableMisses,
+  PC_Count
+};
+
+
+#if GEOM_PROFILE
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+
+class Profiler
+{
+public:
+  static const size_t MaxEvents = 1 << 20;// zones per thread
+
+  struct Zone
+  {
+    const char* name;// has to be a literal, or live as long as the Profiler
+    long long start;// ns
+    long long end;
+  };
+
+  struct ThreadData
+  {
+    long tid;
+    long long counters[PC_Count];
+    long long dropped;// zones past MaxEvents
+    std::vector<Zone> zones;
+  };
+
+  static long long Now()
+  {
+    return static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  // this thread's buffers; registers the thread the first time.
+  static ThreadData& Current()
+  {
+    static thread_local ThreadData* pThread = 0;
+    if(!pThread)
+    {
+      Profiler& p = Instance();
+      std::lock_guard<std::mutex> lock(p.m_mutex);
+      p.m_threads.push_back(std::unique_ptr<ThreadData>(new ThreadData()));
+      pThread = p.m_threads.back().get();
+      pThread->tid = static_cast<long>(p.m_threads.size());
+      memset(pThread->counters, 0, sizeof(pThread->counters));
+      pThread->dropped = 0;
+      pThread->zones.reserve(4096);
+    }
+    return *pThread;
+  }
+
+  static void AddZone(const char* name, long long start, long long end)
+  {
+    ThreadData& t = Current();
+    if(t.zones.size() < MaxEvents)
+    {
+      Zone z = { name, start, end };
+      t.zones.push_back(z);
+    }
+    else
+    {
+      t.dropped ++;
+    }
+  }
+
+  static void EndFrame(long long area)
+  {
+    Profiler& p = Instance();
+    std::lock_guard<std::mutex> lock(p.m_mutex);
+    Sample s;
+    s.time = Now();
+    memset(s.counters, 0, sizeof(s.counters));
+    for(size_t i = 0; i < p.m_threads.size(); i ++)
+    {
+      for(long c = 0; c < PC_Count; c ++)
+      {
+        s.counters[c] += p.m_threads[i]->counters[c];
+        p.m_totals[c] += p.m_threads[i]->counters[c];
+        p.m_threads[i]->counters[c] = 0;
+      }
+    }
+    long long touched = s.counters[PC_PixelsWritten] + s.counters[PC_PixelsBlended];
+    s.overdraw = touched > area ? touched - area : 0;
+    p.m_samples.push_back(s);
+  }
+
+  // every counter summed over all the frames so far.
+  static void GetTotals(long long* counters)
+  {
+    Profiler& p = Instance();
+    std::lock_guard<std::mutex> lock(p.m_mutex);
+    memcpy(counters, p.m_totals, sizeof(p.m_totals));
+  }
+
+  // throws out all the zones, samples and totals.
+  static void Reset()
+  {
+    Profiler& p = Instance();
+    std::lock_guard<std::mutex> lock(p.m_mutex);
+    for(size_t i = 0; i < p.m_threads.size(); i ++)
+    {
+      p.m_threads[i]->zones.clear();
+      p.m_threads[i]->dropped = 0;
+      memset(p.m_threads[i]->counters, 0, sizeof(p.m_threads[i]->counters));
+    }
+    p.m_samples.clear();
+    memset(p.m_totals, 0, sizeof(p.m_totals));
+    p.m_base = Now();
+  }
+
+  // the chrome trace event format ("X" events per zone, "C" events per frame).  nothing may be
+  // drawing while this runs.
+  static bool WriteChromeTrace(const char* path)
+  {
+    bool r = false;
+    Profiler& p = Instance();
+    std::lock_guard<std::mutex> lock(p.m_mutex);
+    FILE* f = fopen(path, "w");
+    if(f)
+    {
+      const char* sep = "";
+      fprintf(f, "{\"traceEvents\":[\n");
+      for(size_t i = 0; i < p.m_threads.size(); i ++)
+      {
+        const ThreadData& t = *p.m_threads[i];
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%ld,\"args\":{\"name\":\"thread %ld\"}}", sep, t.tid, t.tid);
+        sep = ",\n";
+        for(size_t z = 0; z < t.zones.size(); z ++)
+        {
+          fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f}",
+            t.zones[z].name, t.tid, (t.zones[z].start - p.m_base) / 1000.0, (t.zones[z].end - t.zones[z].start) / 1000.0);
+        }
+        if(t.dropped)
+        {
+          fprintf(f, ",\n{\"name\":\"dropped zones\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%ld,\"ts\":0,\"args\":{\"count\":%lld}}", t.tid, t.dropped);
+        }
+      }
+      for(size_t i = 0; i < p.m_samples.size(); i ++)
+      {
+        const Sample& s = p.m_samples[i];
+        fprintf(f, "%s{\"name\":\"pixels\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"written\":%lld,\"blended\":%lld,\"overdraw\":%lld}}",
+          sep, (s.time - p.m_base) / 1000.0, s.counters[PC_PixelsWritten], s.counters[PC_PixelsBlended], s.overdraw);
+        sep = ",\n";
+        fprintf(f, ",\n{\"name\":\"spans\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"spans\":%lld}}",
+          (s.time - p.m_base) / 1000.0, s.counters[PC_Spans]);
+        fprintf(f, ",\n{\"name\":\"circle tables\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"hits\":%lld,\"misses\":%lld}}",
+          (s.time - p.m_base) / 1000.0, s.counters[PC_TableHits], s.counters[PC_TableMisses]);
+      }
+      fprintf(f, "\n]}\n");
+      r = (fclose(f) == 0);
+    }
+    return r;
+  }
+
+private:
+  struct Sample
+  {
+    long long time;
+    long long counters[PC_Count];
+    long long overdraw;
+  };
+
+  Profiler() :
+    m_base(Now())
+  {
+    memset(m_totals, 0, sizeof(m_totals));
+  }
+
+  static Profiler& Instance()
+  {
+    static Profiler instance;
+    return instance;
+  }
+
+  std::mutex m_mutex;
+  std::vector<std::unique_ptr<ThreadData> > m_threads;// never shrinks, so Current()'s pointers stay good
+  std::vector<Sample> m_samples;
+  long long m_totals[PC_Count];
+  long long m_base;// trace timestamps are from here
+};
+
+
+class ProfileZone
+{
+public:
+  explicit ProfileZone(const char* name) :
+    m_name(name),
+    m_start(0)
+  {
+    Profiler::Current();// the first zone starts the Profiler (m_base), so do that before reading the clock
+    m_start = Profiler::Now();
+  }
+
+  ~ProfileZone()
+  {
+    Profiler::AddZone(m_name, m_start, Profiler::Now());
+  }
+
+private:
+  const char* m_name;
+  long long m_start;
+};
+
+
+#define GEOM_PROFILE_CAT2(a, b) a##b
+#define GEOM_PROFILE_CAT(a, b) GEOM_PROFILE_CAT2(a, b)
+
+#define GEOM_ZONE(name) ProfileZone GEOM_PROFILE_CAT(geomZone, __LINE__)(name)
+#define GEOM_COUNT(counter, n) (Profiler::Current().counters[counter] += (n))
+#define GEOM_PROFILE_FRAME(area) Profiler::EndFrame(area)
+
+#else
+
+#define GEOM_ZONE(name)
+#define GEOM_COUNT(counter, n)
+#define GEOM_PROFILE_FRAME(area)
+
+#endif
+
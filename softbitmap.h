@@ -0,0 +1,76 @@
+/*
+  Headless counterpart to AnimBitmap.  Same drawing API (it's all in PixelBuffer), but the pixels
+  live in plain memory that we allocate ourselves instead of in a DIB section, so there is no
+  HDC, no GdiFlush and no windows headers.  Use this for batch rendering and profiling.
+
+  The buffer starts on a 64 byte boundary and every row is padded out to a multiple of 64 bytes,
+  so each row starts on a cache line too.  Use GetPitch() to walk rows, NOT GetWidth().
+
+  Big bitmaps (2MB and up) get huge pages where the OS has them; see hugepage_blob_traits.
+*/
+
+
+#pragma once
+
+
+#include "pixelbuffer.h"
+#include "blob.h"
+
+
+class SoftBitmap : public PixelBuffer
+{
+public:
+  static const long Alignment = 64;// bytes
+  static const long PitchAlignment = Alignment / sizeof(RgbPixel);// pixels
+
+  SoftBitmap()
+  {
+  }
+
+  ~SoftBitmap()
+  {
+    if(m_pbuf)
+    {
+      hugepage_blob_traits::Free(m_pbuf);
+    }
+  }
+
+  // MUST be called at least once.  Contents are undefined after a resize.
+  bool SetSize(long x, long y)
+  {
+    bool r = true;
+
+    if(x < 1) x = 1;
+    if(y < 1) y = 1;
+
+    if((x != m_x) || (y != m_y))
+    {
+      long pitch = (x + PitchAlignment - 1) & ~(PitchAlignment - 1);
+      RgbPixel* pNew = static_cast<RgbPixel*>(hugepage_blob_traits::Alloc(sizeof(RgbPixel) * pitch * y, Alignment));
+
+      r = false;
+      if(pNew)
+      {
+        if(m_pbuf)
+        {
+          hugepage_blob_traits::Free(m_pbuf);
+        }
+        Attach(pNew, x, y, pitch);
+        r = true;
+      }
+    }
+    return r;
+  }
+
+  // these are here so code can be written against either AnimBitmap or SoftBitmap.
+  bool Commit()
+  {
+    return true;
+  }
+
+  bool BeginDraw()
+  {
+    return true;
+  }
+};
+
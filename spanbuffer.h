@@ -0,0 +1,160 @@
+/*
+  Output for the *Spans() rasterizers in geom.h.  Instead of calling back through a member
+  function pointer for every span and every AA pixel, they append to a SpanBuffer, and whoever
+  asked for the shape can chew through the whole list in one tight loop (or hand it off to
+  somebody else).
+
+  The memory belongs to the caller; SpanBuffer never allocates.  If a shape doesn't fit, whatever
+  fits is kept, Overflowed() returns true, and GetSpansNeeded() / GetSamplesNeeded() say how big
+  the arrays would have needed to be.  For a circle or donut of outer radius r, 4*r spans and
+  16*(r+1) samples are always enough.
+
+  Any class with the same AddSpan() / AddCoverage() methods can be used in place of SpanBuffer.
+
+  ClipRect is here too, since it goes along with these everywhere.
+*/
+
+
+#pragma once
+
+
+#include "platform.h"
+
+
+// one horizontal run of solid pixels.  BOTH x1 and x2 are drawn, same as the *G callbacks.
+struct ScanSpan
+{
+  long y;
+  long x1;
+  long x2;
+};
+
+
+// one antialiased pixel.  coverage is 0-255.
+struct CoverageSample
+{
+  long x;
+  long y;
+  BYTE coverage;
+};
+
+
+// left and top are in, right and bottom are out, same as a RECT.
+struct ClipRect
+{
+  long left;
+  long top;
+  long right;
+  long bottom;
+
+  inline bool Contains(long x, long y) const
+  {
+    return (x >= left) && (x < right) && (y >= top) && (y < bottom);
+  }
+
+  // big enough for anything, small enough that nobody overflows adding a radius to it.
+  static ClipRect Everything()
+  {
+    ClipRect r = { -0x10000000, -0x10000000, 0x10000000, 0x10000000 };
+    return r;
+  }
+};
+
+inline ClipRect MakeClipRect(long left, long top, long right, long bottom)
+{
+  ClipRect r = { left, top, right, bottom };
+  return r;
+}
+
+
+class SpanBuffer
+{
+public:
+  SpanBuffer(ScanSpan* pSpans, long nSpanCapacity, CoverageSample* pSamples, long nSampleCapacity) :
+    m_pSpans(pSpans),
+    m_nSpanCapacity(nSpanCapacity),
+    m_nSpans(0),
+    m_pSamples(pSamples),
+    m_nSampleCapacity(nSampleCapacity),
+    m_nSamples(0)
+  {
+  }
+
+  // forget everything so the buffer can be used again.
+  void Reset()
+  {
+    m_nSpans = 0;
+    m_nSamples = 0;
+  }
+
+  inline void AddSpan(long x1, long x2, long y)
+  {
+    if(m_nSpans < m_nSpanCapacity)
+    {
+      ScanSpan& s = m_pSpans[m_nSpans];
+      s.y = y;
+      s.x1 = x1;
+      s.x2 = x2;
+    }
+    m_nSpans ++;
+  }
+
+  inline void AddCoverage(long x, long y, BYTE coverage)
+  {
+    if(m_nSamples < m_nSampleCapacity)
+    {
+      CoverageSample& s = m_pSamples[m_nSamples];
+      s.x = x;
+      s.y = y;
+      s.coverage = coverage;
+    }
+    m_nSamples ++;
+  }
+
+  const ScanSpan* GetSpans() const
+  {
+    return m_pSpans;
+  }
+
+  const CoverageSample* GetSamples() const
+  {
+    return m_pSamples;
+  }
+
+  // # of valid entries in GetSpans() / GetSamples()
+  long GetSpanCount() const
+  {
+    return m_nSpans < m_nSpanCapacity ? m_nSpans : m_nSpanCapacity;
+  }
+
+  long GetSampleCount() const
+  {
+    return m_nSamples < m_nSampleCapacity ? m_nSamples : m_nSampleCapacity;
+  }
+
+  // how many entries were produced since the last Reset(), including ones that didnt fit.
+  long GetSpansNeeded() const
+  {
+    return m_nSpans;
+  }
+
+  long GetSamplesNeeded() const
+  {
+    return m_nSamples;
+  }
+
+  bool Overflowed() const
+  {
+    return (m_nSpans > m_nSpanCapacity) || (m_nSamples > m_nSampleCapacity);
+  }
+
+private:
+  ScanSpan* m_pSpans;
+  long m_nSpanCapacity;
+  long m_nSpans;
+
+  CoverageSample* m_pSamples;
+  long m_nSampleCapacity;
+  long m_nSamples;
+};
+
@@ -0,0 +1,405 @@
+/*
+  Pre-rendered stamps for small circles and donuts.  For a radius of a few pixels, looking up the
+  tables and going through the callbacks costs more than the few dozen pixels that get drawn, so
+  this keeps each shape's coverage (an A8 mask, same as CoverageMask) in an atlas, and drawing
+  one is just a clipped coverage blit through the SIMD kernels (see pixelkernels.h).
+
+    StampCache stamps;// one per thread; it isn't locked
+    stamps.DrawCircle(bmp, x, y, 6, true, MakeRgbPixel(255,255,255));
+    stamps.DrawDonut(bmp, x, y, 4, 3, true, MakeRgbPixel(255,0,0), clip);
+
+  A stamp is keyed on (outer radius, inner radius, AA) and is rasterized the first time it's
+  drawn, with the single pass *Rows code from geom.h, so it's the exact same pixels.  Shapes
+  bigger than MaxRadius aren't cached and just get drawn the normal way, as do ones that don't
+  fit when everything of their size is in use.
+
+  The atlas is one block of "budget" bytes, AtlasWidth wide, cut into shelves as they're needed.
+  Every shelf holds square slots of one size class (8, 16, 32 or 64 pixels), so a slot freed up
+  by eviction fits anything else of its class.  When a class has no free slot and there's no
+  room for another shelf, the least recently drawn stamp of that class gets thrown out.
+*/
+
+
+#pragma once
+
+
+#include <string.h>
+#include <vector>
+#include "platform.h"
+#include "pixelbuffer.h"
+#include "geom.h"
+
+
+class StampCache
+{
+public:
+  static const long MaxRadius = 31;
+  static const long AtlasWidth = 512;// bytes
+  static const size_t DefaultBudget = 256 * 1024;
+
+  explicit StampCache(size_t budget = DefaultBudget) :
+    m_pAtlas(0),
+    m_height(0),
+    m_shelfTop(0),
+    m_clock(0),
+    m_hits(0),
+    m_misses(0),
+    m_evictions(0)
+  {
+    SetBudget(budget);
+  }
+
+  ~StampCache()
+  {
+    if(m_pAtlas)
+    {
+      AlignedFree(m_pAtlas);
+    }
+  }
+
+  // throws out every stamp and resizes the atlas.  rounded down to whole rows of AtlasWidth.
+  bool SetBudget(size_t budget)
+  {
+    bool r = true;
+    long height = static_cast<long>(budget / AtlasWidth);
+    if(height != m_height)
+    {
+      if(m_pAtlas)
+      {
+        AlignedFree(m_pAtlas);
+        m_pAtlas = 0;
+      }
+      m_height = 0;
+      if(height > 0)
+      {
+        m_pAtlas = static_cast<BYTE*>(AlignedAlloc(static_cast<size_t>(AtlasWidth) * height, 64));
+        r = (m_pAtlas != 0);
+        m_height = m_pAtlas ? height : 0;
+      }
+    }
+    Clear();
+    return r;
+  }
+
+  size_t GetBudget() const
+  {
+    return static_cast<size_t>(AtlasWidth) * m_height;
+  }
+
+  void Clear()
+  {
+    m_slots.clear();
+    m_lookup.assign(KeyCount, -1);
+    for(long k = 0; k < ClassCount; k ++)
+    {
+      m_free[k].clear();
+    }
+    m_shelfTop = 0;
+  }
+
+  long GetHits() const { return m_hits; }
+  long GetMisses() const { return m_misses; }
+  long GetEvictions() const { return m_evictions; }
+
+  // these return how many pixels were drawn.
+  long DrawCircle(PixelBuffer& dest, long cx, long cy, long r, bool bAA, RgbPixel c, const ClipRect& clip)
+  {
+    return Draw(dest, cx, cy, r, -1, bAA, c, clip);
+  }
+
+  long DrawCircle(PixelBuffer& dest, long cx, long cy, long r, bool bAA, RgbPixel c)
+  {
+    return Draw(dest, cx, cy, r, -1, bAA, c, ClipRect::Everything());
+  }
+
+  long DrawDonut(PixelBuffer& dest, long cx, long cy, long rin, long width, bool bAA, RgbPixel c, const ClipRect& clip)
+  {
+    return Draw(dest, cx, cy, rin + width, rin, bAA, c, clip);
+  }
+
+  long DrawDonut(PixelBuffer& dest, long cx, long cy, long rin, long width, bool bAA, RgbPixel c)
+  {
+    return Draw(dest, cx, cy, rin + width, rin, bAA, c, ClipRect::Everything());
+  }
+
+private:
+  static const long ClassCount = 4;
+  static const long MaxSide = 8 << (ClassCount - 1);
+  static const long KeyCount = (MaxRadius + 1) * (MaxRadius + 2) * 2;
+
+  // one square of the atlas.  the shape is centered on (half, half) in it, and row y's pixels
+  // are left[y] <= x < right[y].
+  struct Slot
+  {
+    BYTE* p;
+    long sizeClass;
+    long key;// -1 when free
+    unsigned long lastuse;
+    long half;
+    BYTE left[MaxSide];
+    BYTE right[MaxSide];
+  };
+
+  // writes a shape into a slot.  the *Rows code never hits a pixel twice, so it's just stores.
+  class SlotSink
+  {
+  public:
+    SlotSink(Slot& slot, long cx, long cy) :
+      m_slot(slot),
+      m_cx(cx),
+      m_cy(cy)
+    {
+    }
+
+    inline void AddSpan(long x1, long x2, long y)
+    {
+      memset(m_slot.p + ((y + m_cy) * AtlasWidth) + x1 + m_cx, 255, x2 + 1 - x1);
+      Touch(x1 + m_cx, x2 + 1 + m_cx, y + m_cy);
+    }
+
+    inline void AddCoverage(long x, long y, BYTE c)
+    {
+      m_slot.p[((y + m_cy) * AtlasWidth) + x + m_cx] = c;
+      Touch(x + m_cx, x + 1 + m_cx, y + m_cy);
+    }
+
+  private:
+    inline void Touch(long x1, long x2, long y)
+    {
+      if(x1 < m_slot.left[y]) m_slot.left[y] = static_cast<BYTE>(x1);
+      if(x2 > m_slot.right[y]) m_slot.right[y] = static_cast<BYTE>(x2);
+    }
+
+    SlotSink& operator=(const SlotSink&);
+
+    Slot& m_slot;
+    long m_cx;
+    long m_cy;
+  };
+
+  // draws straight into dest, for the shapes that don't get a stamp.
+  class DirectSink
+  {
+  public:
+    DirectSink(PixelBuffer& dest, RgbPixel c) :
+      m_dest(dest),
+      m_c(c),
+      m_pixels(0)
+    {
+    }
+
+    inline void AddSpan(long x1, long x2, long y)
+    {
+      m_dest.HLine(x1, x2 + 1, y, m_c);
+      m_pixels += x2 + 1 - x1;
+    }
+
+    inline void AddCoverage(long x, long y, BYTE c)
+    {
+      m_dest.BlendPixel(x, y, m_c, c);
+      m_pixels ++;
+    }
+
+    long GetPixelCount() const
+    {
+      return m_pixels;
+    }
+
+  private:
+    DirectSink& operator=(const DirectSink&);
+
+    PixelBuffer& m_dest;
+    RgbPixel m_c;
+    long m_pixels;
+  };
+
+  static long GetKey(long rout, long rin, bool bAA)
+  {
+    return (((rout * (MaxRadius + 2)) + rin + 1) * 2) + (bAA ? 1 : 0);
+  }
+
+  static long GetSizeClass(long side)
+  {
+    long k = 0;
+    while((8 << k) < side)
+    {
+      k ++;
+    }
+    return k;
+  }
+
+  static void InitRows(CircleRowList& rows, long rout, long rin, bool bAA)
+  {
+    if(bAA)
+    {
+      std::shared_ptr<const CircleHeightsAA<false> > pOuter = GetCircleTable<CircleHeightsAA<false> >(rout);
+      std::shared_ptr<const CircleHeightsAA<true> > pInner;
+      if(rin >= 0)
+      {
+        pInner = GetCircleTable<CircleHeightsAA<true> >(rin);
+      }
+      rows.Init(*pOuter, pInner.get());
+    }
+    else
+    {
+      std::shared_ptr<const CircleHeights> pOuter = GetCircleTable<CircleHeights>(rout);
+      std::shared_ptr<const CircleHeights> pInner;
+      if(rin >= 0)
+      {
+        pInner = GetCircleTable<CircleHeights>(rin);
+      }
+      rows.Init(*pOuter, pInner.get());
+    }
+  }
+
+  // a slot of the given class to put a new stamp in: a free one, a new shelf's, or the least
+  // recently used one.  -1 if the class has no slots at all and there's no room for a shelf.
+  long GetFreeSlot(long sizeClass)
+  {
+    long side = 8 << sizeClass;
+    if(m_free[sizeClass].empty() && m_shelfTop + side <= m_height)
+    {
+      for(long x = 0; x + side <= AtlasWidth; x += side)
+      {
+        Slot s;
+        s.p = m_pAtlas + (m_shelfTop * AtlasWidth) + x;
+        s.sizeClass = sizeClass;
+        s.key = -1;
+        s.lastuse = 0;
+        s.half = 0;
+        m_free[sizeClass].push_back(static_cast<long>(m_slots.size()));
+        m_slots.push_back(s);
+      }
+      m_shelfTop += side;
+    }
+
+    long r = -1;
+    if(!m_free[sizeClass].empty())
+    {
+      r = m_free[sizeClass].back();
+      m_free[sizeClass].pop_back();
+    }
+    else
+    {
+      for(size_t i = 0; i < m_slots.size(); i ++)
+      {
+        if(m_slots[i].sizeClass == sizeClass && (r < 0 || m_slots[i].lastuse < m_slots[r].lastuse))
+        {
+          r = static_cast<long>(i);
+        }
+      }
+      if(r >= 0)
+      {
+        m_lookup[m_slots[r].key] = -1;
+        m_evictions ++;
+      }
+    }
+    return r;
+  }
+
+  // the slot with this shape in it, rasterizing it if need be.  -1 if it can't have one.
+  long GetStamp(long rout, long rin, bool bAA)
+  {
+    if(rout < 1 || rout > MaxRadius || rin >= rout || !m_pAtlas)
+    {
+      return -1;
+    }
+
+    long key = GetKey(rout, rin, bAA);
+    long r = m_lookup[key];
+    if(r >= 0)
+    {
+      m_hits ++;
+      m_slots[r].lastuse = ++ m_clock;
+      return r;
+    }
+
+    m_misses ++;
+    CircleRowList rows;
+    InitRows(rows, rout, rin, bAA);
+    long half = rows.GetRowCount();
+    if(half < 1 || 2 * half > MaxSide)
+    {
+      return -1;
+    }
+
+    r = GetFreeSlot(GetSizeClass(2 * half));
+    if(r >= 0)
+    {
+      Slot& s = m_slots[r];
+      long side = 8 << s.sizeClass;
+      for(long y = 0; y < side; y ++)
+      {
+        memset(s.p + (y * AtlasWidth), 0, side);
+        s.left[y] = static_cast<BYTE>(side);
+        s.right[y] = 0;
+      }
+      s.key = key;
+      s.half = half;
+      s.lastuse = ++ m_clock;
+      SlotSink sink(s, half, half);
+      CircleRows(rows, 0, 0, MakeClipRect(-half, -half, half, half), sink);
+      m_lookup[key] = r;
+    }
+    return r;
+  }
+
+  long Draw(PixelBuffer& dest, long cx, long cy, long rout, long rin, bool bAA, RgbPixel c, const ClipRect& clipIn)
+  {
+    long n = 0;
+    ClipRect clip = clipIn;
+    if(clip.left < 0) clip.left = 0;
+    if(clip.top < 0) clip.top = 0;
+    if(clip.right > dest.GetWidth()) clip.right = dest.GetWidth();
+    if(clip.bottom > dest.GetHeight()) clip.bottom = dest.GetHeight();
+    if(!IsBoxVisible(clip, cx - rout - 1, cy - rout - 1, cx + rout, cy + rout))
+    {
+      return n;
+    }
+
+    long i = GetStamp(rout, rin, bAA);
+    if(i < 0)
+    {
+      DirectSink sink(dest, c);
+      CircleRowList rows;
+      InitRows(rows, rout, rin, bAA);
+      CircleRows(rows, cx, cy, clip, sink);
+      return sink.GetPixelCount();
+    }
+
+    const Slot& s = m_slots[i];
+    long x0 = cx - s.half;
+    long y0 = cy - s.half;
+    long side = 2 * s.half;
+    long sy0 = clip.top - y0 > 0 ? clip.top - y0 : 0;
+    long sy1 = clip.bottom - y0 < side ? clip.bottom - y0 : side;
+    for(long sy = sy0; sy < sy1; sy ++)
+    {
+      long left = s.left[sy];
+      long right = s.right[sy];
+      if(x0 + left < clip.left) left = clip.left - x0;
+      if(x0 + right > clip.right) right = clip.right - x0;
+      if(left < right)
+      {
+        dest.BlendCoverageRow(x0 + left, y0 + sy, s.p + (sy * AtlasWidth) + left, right - left, c);
+        n += right - left;
+      }
+    }
+    return n;
+  }
+
+  StampCache(const StampCache&);
+  StampCache& operator=(const StampCache&);
+
+  BYTE* m_pAtlas;
+  long m_height;// rows of AtlasWidth
+  long m_shelfTop;// first row that isn't in a shelf yet
+  std::vector<Slot> m_slots;
+  std::vector<long> m_lookup;// key -> slot, or -1
+  std::vector<long> m_free[ClassCount];// free slots of each size class
+  unsigned long m_clock;
+  long m_hits;
+  long m_misses;
+  long m_evictions;
+};
+
@@ -0,0 +1,313 @@
+/*
+  A few bitmaps to render into, and a thread that consumes the finished ones (shows them,
+  encodes them, whatever), so rendering frame n+1 overlaps with consuming frame n.
+
+    struct Encoder { void operator()(SoftBitmap& bmp) { ... } } encoder;
+    SwapChain<SoftBitmap> chain(2);
+    chain.SetSize(w, h);
+    chain.Start(encoder);// encoder(bmp) is called on the consumer thread, in frame order
+    while(each frame)
+    {
+      SoftBitmap& bmp = chain.BeginFrame();// waits for a free buffer
+      // draw...
+      chain.EndFrame();// hands it over
+    }
+    chain.Stop();// waits for everything handed over to be consumed
+
+  The buffer indices go around through two rings (free and ready) with one thread on each end,
+  so handing a frame over takes no lock.  Whoever is waiting spins, then yields, then naps.
+  BeginFrame(), EndFrame() and SetSize() belong to one thread, the "producer".  Without a
+  consumer (before Start()) frames are just thrown away at EndFrame().
+
+  With one buffer it's the old serial loop, only on two threads.  Two let a frame render while the
+  last one is consumed; three give the renderer slack when consuming takes a varying amount of
+  time.
+
+  Dirty tracking (see PixelBuffer) is per buffer, so ClearDirty() still erases the right thing.
+  But what's on screen came from the buffer before, so the consumer thread adds the rows drawn
+  there to each buffer's dirty rects before handing it over, and BlitDirty() in the consumer
+  sends everything that changed.
+
+  GetRenderTime() is BeginFrame() to EndFrame(), not counting the wait for a buffer, and
+  GetLatency() is BeginFrame() to the consumer being done with that frame.  Both are in seconds,
+  for the last frame.
+*/
+
+
+#pragma once
+
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+template<typename Tbmp>
+class SwapChain
+{
+public:
+  static const long MaxBuffers = 3;
+
+  explicit SwapChain(long nBuffers = 2) :
+    m_nBuffers(nBuffers < 1 ? 1 : (nBuffers > MaxBuffers ? MaxBuffers : nBuffers)),
+    m_back(-1),
+    m_quit(false),
+    m_bRunning(false),
+    m_pProc(0),
+    m_pContext(0),
+    m_render(0),
+    m_latency(0),
+    m_consumed(0)
+  {
+    for(long i = 0; i < m_nBuffers; i ++)
+    {
+      m_begin[i] = 0;
+      m_free.Push(i);
+    }
+  }
+
+  ~SwapChain()
+  {
+    Stop();
+  }
+
+  long GetBufferCount() const
+  {
+    return m_nBuffers;
+  }
+
+  Tbmp& GetBuffer(long i)
+  {
+    return m_buffers[i];
+  }
+
+  // waits for the consumer to give every buffer back, then resizes them all.
+  bool SetSize(long x, long y)
+  {
+    bool r = true;
+    long spins = 0;
+    while(m_free.GetCount() != m_nBuffers)
+    {
+      Wait(spins);
+    }
+    for(long i = 0; i < m_nBuffers; i ++)
+    {
+      if(!m_buffers[i].SetSize(x, y))
+      {
+        r = false;
+      }
+    }
+    return r;
+  }
+
+  // consume(bmp) gets called on its own thread for every frame.  it has to stay around until Stop().
+  template<typename Tconsume>
+  void Start(Tconsume& consume)
+  {
+    Stop();
+    m_pProc = &SwapChain::Thunk<Tconsume>;
+    m_pContext = &consume;
+    m_quit.store(false);
+    m_bRunning = true;
+    m_thread = std::thread(&SwapChain::ConsumerMain, this);
+  }
+
+  // everything handed over so far gets consumed first.
+  void Stop()
+  {
+    if(m_bRunning)
+    {
+      m_quit.store(true, std::memory_order_release);
+      m_thread.join();
+      m_bRunning = false;
+      m_pProc = 0;
+      m_pContext = 0;
+    }
+  }
+
+  // the buffer to draw the next frame into.  waits for one if they're all in use.
+  Tbmp& BeginFrame()
+  {
+    long spins = 0;
+    while(!m_free.Pop(m_back))
+    {
+      Wait(spins);
+    }
+    m_begin[m_back] = Now();
+    m_buffers[m_back].BeginDraw();
+    return m_buffers[m_back];
+  }
+
+  long GetBackBufferIndex() const
+  {
+    return m_back;
+  }
+
+  void EndFrame()
+  {
+    Tbmp& bmp = m_buffers[m_back];
+    bmp.Commit();
+    m_render = Now() - m_begin[m_back];
+    if(m_bRunning)
+    {
+      m_ready.Push(m_back);
+    }
+    else
+    {
+      m_latency.store(m_render);
+      m_free.Push(m_back);
+    }
+    m_back = -1;
+  }
+
+  double GetRenderTime() const
+  {
+    return static_cast<double>(m_render) / 1e9;
+  }
+
+  double GetLatency() const
+  {
+    return static_cast<double>(m_latency.load()) / 1e9;
+  }
+
+  // # of frames the consumer is done with.
+  long long GetConsumedCount() const
+  {
+    return m_consumed.load();
+  }
+
+private:
+  typedef void (*ConsumeProc)(void* pContext, Tbmp& bmp);
+
+  // buffer indices, pushed on one thread and popped on another.  there are never more than
+  // MaxBuffers of them, so it can't fill up.
+  class IndexRing
+  {
+  public:
+    IndexRing() :
+      m_head(0),
+      m_tail(0)
+    {
+    }
+
+    void Push(long i)
+    {
+      unsigned long t = m_tail.load(std::memory_order_relaxed);
+      m_items[t % Capacity] = i;
+      m_tail.store(t + 1, std::memory_order_release);
+    }
+
+    bool Pop(long& i)
+    {
+      bool r = false;
+      unsigned long h = m_head.load(std::memory_order_relaxed);
+      if(h != m_tail.load(std::memory_order_acquire))
+      {
+        i = m_items[h % Capacity];
+        m_head.store(h + 1, std::memory_order_release);
+        r = true;
+      }
+      return r;
+    }
+
+    long GetCount() const
+    {
+      return static_cast<long>(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+    }
+
+  private:
+    static const unsigned long Capacity = 4;// a power of 2, so wrapping around is fine
+
+    long m_items[Capacity];
+    std::atomic<unsigned long> m_head;
+    std::atomic<unsigned long> m_tail;
+  };
+
+  template<typename Tconsume>
+  static void Thunk(void* pContext, Tbmp& bmp)
+  {
+    (*static_cast<Tconsume*>(pContext))(bmp);
+  }
+
+  static long long Now()
+  {
+    return static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  // spin a little, then yield, then sleep.
+  static void Wait(long& spins)
+  {
+    if(spins >= 1024)
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    else if(spins >= 64)
+    {
+      std::this_thread::yield();
+    }
+    spins ++;
+  }
+
+  void ConsumerMain()
+  {
+    long spins = 0;
+    for(;;)
+    {
+      // checked before the pop, so nothing pushed before Stop() gets left behind
+      bool bQuit = m_quit.load(std::memory_order_acquire);
+      long i;
+      if(m_ready.Pop(i))
+      {
+        Tbmp& bmp = m_buffers[i];
+        if(bmp.GetDirtyTracking())
+        {
+          bmp.AddStaleRows(m_shownLeft, m_shownRight);
+        }
+        m_pProc(m_pContext, bmp);
+        if(bmp.GetDirtyTracking())
+        {
+          bmp.GetDrawnRows(m_shownLeft, m_shownRight);
+        }
+        m_latency.store(Now() - m_begin[i]);
+        m_consumed ++;
+        m_free.Push(i);
+        spins = 0;
+      }
+      else if(bQuit)
+      {
+        break;
+      }
+      else
+      {
+        Wait(spins);
+      }
+    }
+  }
+
+  SwapChain(const SwapChain&);
+  SwapChain& operator=(const SwapChain&);
+
+  Tbmp m_buffers[MaxBuffers];
+  long long m_begin[MaxBuffers];// when each buffer's frame started, in ns
+  long m_nBuffers;
+  long m_back;// the buffer between BeginFrame() and EndFrame(), or -1
+  IndexRing m_free;
+  IndexRing m_ready;
+
+  std::thread m_thread;
+  std::atomic<bool> m_quit;
+  bool m_bRunning;
+  ConsumeProc m_pProc;
+  void* m_pContext;
+
+  // the rows drawn in the last frame consumed; consumer thread only.
+  std::vector<long> m_shownLeft;
+  std::vector<long> m_shownRight;
+
+  long long m_render;// ns
+  std::atomic<long long> m_latency;// ns
+  std::atomic<long long> m_consumed;
+};
+
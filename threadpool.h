@@ -0,0 +1,190 @@
+/*
+  A small fixed-size thread pool for splitting one job up over all the cores.
+
+  ThreadPool& pool = ThreadPool::Default();
+  pool.Run(nBands, [&](long band)
+  {
+    // do band # "band"
+  });
+
+  Run() hands out indices 0..n-1 to whoever is free (the calling thread helps too), and doesn't
+  return until all of them are done.  Tasks are grabbed one at a time, so it's fine to make more
+  of them than there are threads; uneven tasks even out that way.
+
+  One Run() at a time per pool - other callers wait their turn.  Don't call Run() from inside a
+  task on the same pool; it will deadlock.
+*/
+
+
+#pragma once
+
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool
+{
+public:
+  // nThreads includes the calling thread.  0 means one per core.
+  explicit ThreadPool(long nThreads = 0) :
+    m_quit(false),
+    m_generation(0),
+    m_busy(0),
+    m_pProc(0),
+    m_pContext(0),
+    m_nTasks(0),
+    m_next(0)
+  {
+    if(nThreads < 1)
+    {
+      nThreads = static_cast<long>(std::thread::hardware_concurrency());
+      if(nThreads < 1) nThreads = 1;
+    }
+
+    for(long i = 1; i < nThreads; i ++)
+    {
+      m_threads.push_back(std::thread(&ThreadPool::WorkerMain, this));
+    }
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+    }
+    m_wake.notify_all();
+    for(size_t i = 0; i < m_threads.size(); i ++)
+    {
+      m_threads[i].join();
+    }
+  }
+
+  // the pool shared by everything that doesn't bring its own.
+  static ThreadPool& Default()
+  {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  // # of threads that work on a Run(), counting the caller.
+  long GetThreadCount() const
+  {
+    return static_cast<long>(m_threads.size()) + 1;
+  }
+
+  // calls task(i) for every i from 0 to n-1, spread over the pool.
+  template<typename Ttask>
+  void Run(long n, const Ttask& task)
+  {
+    if(n < 1)
+    {
+      return;
+    }
+
+    if(n == 1 || m_threads.empty())
+    {
+      for(long i = 0; i < n; i ++)
+      {
+        task(i);
+      }
+      return;
+    }
+
+    std::lock_guard<std::mutex> runlock(m_runMutex);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_pProc = &ThreadPool::Thunk<Ttask>;
+      m_pContext = &task;
+      m_nTasks = n;
+      m_next.store(0);
+      m_busy = static_cast<long>(m_threads.size());
+      m_generation ++;
+    }
+    m_wake.notify_all();
+
+    DoTasks(m_pProc, m_pContext, n);
+
+    // every worker has to check in, even the ones that got nothing, so none of them can still be
+    // looking at "task" after we return.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(m_busy != 0)
+    {
+      m_done.wait(lock);
+    }
+    m_pProc = 0;
+    m_pContext = 0;
+  }
+
+private:
+  typedef void (*TaskProc)(const void* pContext, long i);
+
+  template<typename Ttask>
+  static void Thunk(const void* pContext, long i)
+  {
+    (*static_cast<const Ttask*>(pContext))(i);
+  }
+
+  void DoTasks(TaskProc pProc, const void* pContext, long n)
+  {
+    long i;
+    while((i = m_next.fetch_add(1)) < n)
+    {
+      pProc(pContext, i);
+    }
+  }
+
+  void WorkerMain()
+  {
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for(;;)
+    {
+      while(!m_quit && m_generation == seen)
+      {
+        m_wake.wait(lock);
+      }
+      if(m_quit)
+      {
+        break;
+      }
+
+      seen = m_generation;
+      TaskProc pProc = m_pProc;
+      const void* pContext = m_pContext;
+      long n = m_nTasks;
+
+      lock.unlock();
+      DoTasks(pProc, pContext, n);
+      lock.lock();
+
+      m_busy --;
+      if(m_busy == 0)
+      {
+        m_done.notify_one();
+      }
+    }
+  }
+
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  std::vector<std::thread> m_threads;
+  std::mutex m_runMutex;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  bool m_quit;
+  unsigned long m_generation;
+  long m_busy;
+
+  TaskProc m_pProc;
+  const void* m_pContext;
+  long m_nTasks;
+  std::atomic<long> m_next;
+};
+